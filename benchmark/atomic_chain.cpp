@@ -0,0 +1,94 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how many snapshots readers can load from an atomic chain,
+// with and without a writer replacing it as fast as it can, and how that
+// compares to guarding a plain chain with a mutex. The number of readers can
+// be given as the first argument.
+#include <chain/atomic_chain.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The chain shared through a mutex.
+struct locked_chain {
+  std::mutex mutex;
+  chain::chain shared;
+
+  chain::chain load() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return shared;
+  }
+
+  void store(chain::chain c) {
+    std::lock_guard<std::mutex> lock(mutex);
+    shared = std::move(c);
+  }
+};
+
+// Runs the readers for a while, with a writer storing one of the versions
+// after the other if there's to be one, and returns the loads per second.
+template <class Shared>
+double loads_per_second(Shared &shared, size_t readers, bool writing,
+                        std::vector<chain::chain> const &versions) {
+  std::atomic<bool> done(false);
+  std::atomic<size_t> loads(0), stores(0);
+  std::vector<std::thread> threads;
+  for (size_t r = 0; r < readers; ++r) {
+    threads.emplace_back([&] {
+      size_t local = 0, elements = 0;
+      while (!done) {
+        elements += shared.load().size();
+        ++local;
+      }
+      loads += local + (elements == 0);
+    });
+  }
+  if (writing) {
+    threads.emplace_back([&] {
+      size_t local = 0;
+      while (!done) shared.store(versions[local++ % versions.size()]);
+      stores += local;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  done = true;
+  for (std::thread &t : threads) t.join();
+  return loads / 0.5;
+}
+
+int main(int argc, char *argv[]) {
+  using chain::atomic_chain;
+  using chain::chain;
+
+  size_t readers = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4;
+  std::vector<chain> versions;
+  for (int v = 0; v < 16; ++v) versions.push_back(chain(std::string(4096 + v, 'x')));
+
+  std::printf("%zu readers, loads per second\n", readers);
+  std::printf("%-14s %14s %14s\n", "", "no writer", "writer");
+  for (bool atomic : {true, false}) {
+    double quiet, busy;
+    if (atomic) {
+      atomic_chain<chain> shared(versions[0]);
+      quiet = loads_per_second(shared, readers, false, versions);
+      busy = loads_per_second(shared, readers, true, versions);
+    } else {
+      locked_chain shared;
+      shared.store(versions[0]);
+      quiet = loads_per_second(shared, readers, false, versions);
+      busy = loads_per_second(shared, readers, true, versions);
+    }
+    std::printf("%-14s %14.0f %14.0f\n", atomic ? "atomic_chain" : "mutex", quiet,
+                busy);
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how fast chains can be constructed and destroyed when there
+// are always about the same number of them alive, the way a server handling
+// requests churns through them, and how much memory that takes. The pages of
+// the chains that go away are either pooled for the chains that come after
+// them or go straight back to the allocator. Since the resident set size only
+// ever makes sense for the whole process, each run is its own process:
+//
+//   churn_benchmark pooled
+//   churn_benchmark unpooled
+#include <chain/chain.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+// The resident set size of the process right now, in kilobytes.
+long resident_kilobytes() {
+  long pages = 0, resident = 0;
+  if (FILE *statm = std::fopen("/proc/self/statm", "r")) {
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(statm);
+  }
+  return resident * (getpagesize() / 1024);
+}
+
+int main(int argc, char *argv[]) {
+  typedef chain::page_pool<chain::chain> pool;
+  using chain::chain;
+
+  bool pooled = argc < 2 || std::strcmp(argv[1], "unpooled") != 0;
+  if (!pooled) pool::set_watermarks(0, 0);
+
+  // The contents are made up front so that building them doesn't get in the
+  // way of what we're measuring.
+  std::mt19937 random(42);
+  std::uniform_int_distribution<size_t> length(200, 20000);
+  std::vector<std::string> contents;
+  for (int i = 0; i < 64; ++i) contents.push_back(std::string(length(random), 'x'));
+  std::vector<chain> live(1024);
+  size_t const rounds = 1000000;
+  size_t elements = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i) {
+    std::string const &c = contents[random() % contents.size()];
+    live[random() % live.size()] = chain(c);
+    elements += c.size();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  std::printf("%s: %.0f chains/s, %.2f GB/s, %ld KB resident, %ld KB peak, "
+              "%zu pages pooled\n",
+              pooled ? "pooled" : "unpooled", rounds / elapsed.count(),
+              elements / elapsed.count() / (1 << 30), resident_kilobytes(),
+              usage.ru_maxrss, pool::size());
+  return 0;
+}
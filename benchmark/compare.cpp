@@ -0,0 +1,70 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how sorting chains compares to sorting the strings they were
+// made from. The keys share long prefixes, the way paths and URLs do, so most
+// comparisons have to look past the first few elements. The number of keys can
+// be given as the first argument.
+#include <chain/chain.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+template <class Function>
+double seconds(Function f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+  using chain::chain;
+
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  std::mt19937 random(42);
+  std::vector<std::string> strings;
+  strings.reserve(count);
+  char key[128];
+  for (size_t i = 0; i < count; ++i) {
+    std::snprintf(key, sizeof(key),
+                  "https://example.com/accounts/%04u/documents/%08u/revision",
+                  unsigned(random() % 64), unsigned(random()));
+    strings.push_back(key);
+  }
+  std::vector<chain> chains(strings.begin(), strings.end());
+
+  std::printf("%zu keys\n", count);
+  std::vector<std::string> sorted_strings(strings);
+  std::vector<chain> sorted_chains(chains);
+  std::printf("sort std::string  %8.3f s\n", seconds([&] {
+    std::sort(sorted_strings.begin(), sorted_strings.end());
+  }));
+  std::printf("sort chain        %8.3f s\n", seconds([&] {
+    std::sort(sorted_chains.begin(), sorted_chains.end());
+  }));
+  for (size_t i = 0; i < count; ++i) {
+    if (sorted_chains[i] != chain(sorted_strings[i])) {
+      std::printf("mismatch at %zu\n", i);
+      return 1;
+    }
+  }
+
+  std::printf("map std::string   %8.3f s\n", seconds([&] {
+    std::map<std::string, size_t> m;
+    for (size_t i = 0; i < count; ++i) m[strings[i]] = i;
+  }));
+  std::printf("map chain         %8.3f s\n", seconds([&] {
+    std::map<chain, size_t> m;
+    for (size_t i = 0; i < count; ++i) m[chains[i]] = i;
+  }));
+  return 0;
+}
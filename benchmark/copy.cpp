@@ -0,0 +1,117 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how fast the contents of a chain can be copied into new
+// pages, which is what swapping chains with allocators that don't compare equal
+// has to do. The source is fragmented into links that don't line up with the
+// pages, the way chains put together from slices are. The size of the source in
+// megabytes can be given as the first argument.
+#include <chain/chain.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+template <class T>
+struct tagged_allocator {
+  typedef T value_type;
+  int tag;
+
+  tagged_allocator() : tag(0) {}
+  explicit tagged_allocator(int tag) : tag(tag) {}
+  template <class U>
+  tagged_allocator(tagged_allocator<U> const &other) : tag(other.tag) {}
+
+  T *allocate(std::size_t n) { return std::allocator<T>().allocate(n); }
+  void deallocate(T *p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+
+  bool operator==(tagged_allocator const &other) const { return tag == other.tag; }
+  bool operator!=(tagged_allocator const &other) const { return tag != other.tag; }
+};
+
+typedef chain::chain_t<char, tagged_allocator<char>> tagged_chain;
+typedef chain::detail::block_links<char, tagged_allocator<char>> links_type;
+typedef chain::detail::block_writer<char, tagged_allocator<char>> writer_type;
+
+// Times copying the links with the given copy function, not counting the time
+// it takes to let go of the copy afterwards.
+template <class Copy>
+double best_of(int runs, links_type const &links, tagged_allocator<char> *allocator,
+               Copy copy) {
+  double best = 1e30;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    writer_type writer(allocator);
+    copy(writer, links);
+    links_type *copied = writer.finish();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    links_type::release(copied);
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+  size_t size = megabytes << 20;
+  std::basic_string<char, std::char_traits<char>, tagged_allocator<char>> contents(
+      size, 'x');
+  tagged_chain whole(contents);
+  contents.clear();
+  // Every piece skips the element after it so that consecutive pieces in the
+  // same page don't get merged back into one link.
+  links_type *pieces =
+      links_type::make(chain::detail::chain_access::allocator(whole));
+  for (auto const &link : *chain::detail::chain_access::links(whole)) {
+    size_t step = 1000;
+    for (size_t offset = 0; offset < link.length;
+         offset += step + 1, step = step * 7 % 3001 + 500) {
+      links_type::block_type::acquire(link.target);
+      pieces->push_link(link.target, link.offset + offset,
+                        std::min(step, link.length - offset));
+    }
+  }
+  tagged_chain source = chain::detail::chain_access::make(
+      chain::detail::chain_access::allocator(whole), pieces);
+  links_type const &links = *chain::detail::chain_access::links(source);
+  size_t link_count = links.link_count();
+  tagged_allocator<char> other_allocator(1);
+
+  std::printf("%zu MB in %zu links\n", megabytes, link_count);
+  double seconds = best_of(3, links, &other_allocator,
+                           [](writer_type &writer, links_type const &links) {
+    for (auto const &link : links) {
+      writer.write(link.data(), link.length);
+    }
+  });
+  std::printf("%-24s %6.2f GB/s\n", "element-wise copy", megabytes / 1024.0 / seconds);
+  seconds = best_of(3, links, &other_allocator,
+                    [](writer_type &writer, links_type const &links) {
+    chain::detail::bulk_copy(writer, links, false);
+  });
+  std::printf("%-24s %6.2f GB/s\n", "bulk copy", megabytes / 1024.0 / seconds);
+  seconds = best_of(3, links, &other_allocator,
+                    [](writer_type &writer, links_type const &links) {
+    chain::detail::bulk_copy(writer, links, true);
+  });
+  std::printf("%-24s %6.2f GB/s\n", "bulk copy, streaming", megabytes / 1024.0 / seconds);
+
+  // Swapping copies the contents one way, and swapping back copies them back.
+  tagged_chain other(&other_allocator);
+  double best = 1e30;
+  for (int i = 0; i < 3; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    other.swap(source);
+    source.swap(other);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  std::printf("%-24s %6.2f GB/s\n", "swap and swap back", 2 * megabytes / 1024.0 / best);
+  return 0;
+}
@@ -0,0 +1,184 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see what small edits to a large document cost. We make random
+// inserts, erases and replacements of a few elements each on a 10 MB chain,
+// both as independent edits of the same document and as one edit after the
+// other, and compare that to making the same edits to a std::string. We then
+// replace every placeholder in a 10 MB template, which is what rendering and
+// sanitizing text does. The number of independent edits can be given as the
+// first argument.
+#include <chain/chain.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+template <class Function>
+double seconds(Function f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+struct edit {
+  int kind;
+  size_t position, length;
+};
+
+// Random edits that stay within a document of the given size, which changes
+// with every edit if they're made one after the other.
+std::vector<edit> random_edits(size_t count, size_t size, bool successive,
+                               std::mt19937 &random) {
+  std::vector<edit> edits;
+  for (size_t i = 0; i < count; ++i) {
+    edit e = {int(random() % 3), random() % (size - 16), 1 + random() % 8};
+    edits.push_back(e);
+    if (successive) size += e.kind == 0 ? 5 : e.kind == 1 ? -e.length : 5 - e.length;
+  }
+  return edits;
+}
+
+chain::chain apply(chain::chain const &c, edit const &e, chain::chain const &text) {
+  switch (e.kind) {
+    case 0: return c.insert(e.position, text);
+    case 1: return c.erase(e.position, e.length);
+    default: return c.replace(e.position, e.length, text);
+  }
+}
+
+void apply(std::string &s, edit const &e, std::string const &text) {
+  switch (e.kind) {
+    case 0: s.insert(e.position, text); break;
+    case 1: s.erase(e.position, e.length); break;
+    default: s.replace(e.position, e.length, text); break;
+  }
+}
+
+// Replacing every needle in a string builds a new one the way rendering a
+// template into a string would.
+std::string replace_all(std::string const &s, std::string const &needle,
+                        std::string const &replacement) {
+  std::string replaced;
+  size_t kept = 0;
+  for (size_t found = s.find(needle); found != std::string::npos;
+       found = s.find(needle, kept)) {
+    replaced.append(s, kept, found - kept).append(replacement);
+    kept = found + needle.size();
+  }
+  return replaced.append(s, kept, std::string::npos);
+}
+
+size_t link_count(chain::chain const &c) {
+  return chain::detail::chain_access::links(c)->link_count();
+}
+
+int main(int argc, char *argv[]) {
+  using chain::chain;
+
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  size_t const size = 10 << 20;
+  std::mt19937 random(42);
+  std::vector<char> contents(size);
+  for (char &c : contents) c = char('a' + random() % 26);
+  std::string flat(contents.begin(), contents.end());
+  // A document read into a buffer of its own is adopted as it is, while one
+  // built from a string goes into pages.
+  std::vector<char> buffer(contents);
+  chain adopted(std::move(buffer)), paged(flat);
+  chain text("12345");
+  std::string flat_text("12345");
+
+  std::printf("%zu independent edits of a 10 MB document\n", count);
+  std::vector<edit> edits = random_edits(count, size, false, random);
+  size_t elements = 0;
+  for (chain const *document : {&adopted, &paged}) {
+    double elapsed = seconds([&] {
+      for (edit const &e : edits) {
+        elements += apply(*document, e, text).size();
+      }
+    });
+    std::printf("%-22s %10.0f ns per edit (%zu links)\n",
+                document == &adopted ? "chain, adopted buffer" : "chain, pages",
+                elapsed / count * 1e9,
+                link_count(*document));
+  }
+  size_t const copies = 200;
+  double copied = seconds([&] {
+    for (size_t i = 0; i < copies; ++i) {
+      std::string edited(flat);
+      apply(edited, edits[i], flat_text);
+      elements += edited.size();
+    }
+  });
+  std::printf("%-22s %10.0f ns per edit\n", "std::string copy", copied / copies * 1e9);
+
+  // One edit after the other adds links as it goes, so each edit costs more
+  // than the one before it.
+  size_t const successive = 10000;
+  std::vector<edit> more = random_edits(successive, size, true, random);
+  chain document = adopted;
+  double chained = seconds([&] {
+    for (edit const &e : more) document = apply(document, e, text);
+  });
+  std::string edited(flat);
+  double in_place = seconds([&] {
+    for (edit const &e : more) apply(edited, e, flat_text);
+  });
+  if (document != chain(edited)) {
+    std::printf("mismatch\n");
+    return 1;
+  }
+  std::printf("%zu successive edits\n", successive);
+  std::printf("%-22s %10.0f ns per edit (%zu links at the end)\n", "chain",
+              chained / successive * 1e9,
+              link_count(document));
+  std::printf("%-22s %10.0f ns per edit\n", "std::string in place",
+              in_place / successive * 1e9);
+
+  // A placeholder about every kilobyte, in a template that's been read into
+  // a buffer of its own.
+  std::string source, page;
+  for (size_t i = 0; i < size; i += page.size()) {
+    page.assign(flat, i % (size - 2048), 1000 + random() % 48);
+    page += "{{name}}";
+    source.append(page);
+  }
+  source.resize(size);
+  std::vector<char> template_buffer(source.begin(), source.end());
+  chain templated(std::move(template_buffer));
+  chain needle("{{name}}"), name("Aloha, world");
+  size_t const renders = 20;
+  chain rendered;
+  double linked = seconds([&] {
+    for (size_t i = 0; i < renders; ++i) {
+      rendered = templated.replace_all(needle, name);
+      elements += rendered.size();
+    }
+  });
+  std::string flat_rendered;
+  double flattened = seconds([&] {
+    for (size_t i = 0; i < renders; ++i) {
+      flat_rendered = replace_all(source, "{{name}}", "Aloha, world");
+      elements += flat_rendered.size();
+    }
+  });
+  if (rendered != chain(flat_rendered)) {
+    std::printf("mismatch\n");
+    return 1;
+  }
+  size_t links = link_count(rendered);
+  std::printf("replacing every placeholder in a 10 MB template\n");
+  std::printf("%-22s %10.2f ms per render (%zu links, %zu bytes of links)\n",
+              "chain", linked / renders * 1e3, links,
+              links * sizeof(::chain::detail::packed_link<char, std::allocator<char>>));
+  std::printf("%-22s %10.2f ms per render (%zu bytes)\n", "std::string",
+              flattened / renders * 1e3, flat_rendered.size());
+  return elements == 0;
+}
@@ -0,0 +1,96 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see what it costs to index the lines of a large log, to ask
+// which line an offset is on and where a line is, and to index slices and
+// concatenations of a log that's already indexed. We compare the queries to
+// counting newlines up to the offset, which is what answering them without an
+// index takes. The size of the log in megabytes can be given as the first
+// argument.
+#include <chain/line_index.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+template <class Function>
+double seconds(Function f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+  using chain::line_index;
+  using chain::chain;
+  typedef line_index<chain> index_type;
+
+  size_t const megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+  size_t const size = megabytes << 20;
+  std::mt19937 random(42);
+  std::string log;
+  log.reserve(size + 200);
+  while (log.size() < size) {
+    size_t length = 20 + random() % 100;
+    for (size_t i = 0; i < length; ++i) log += char('a' + random() % 26);
+    log += '\n';
+  }
+  chain paged(log);
+
+  index_type *lines_of_log = nullptr;
+  double indexed = seconds([&] { lines_of_log = new index_type(paged); });
+  size_t lines = lines_of_log->line_count();
+  std::printf("indexing %zu MB with %zu lines: %.1f ms\n", megabytes, lines,
+              indexed * 1e3);
+
+  size_t const queries = 1000000;
+  size_t checksum = 0;
+  double found_lines = seconds([&] {
+    for (size_t i = 0; i < queries; ++i) {
+      checksum += lines_of_log->line(random() % lines).size();
+    }
+  });
+  double found_offsets = seconds([&] {
+    for (size_t i = 0; i < queries; ++i) {
+      checksum += lines_of_log->line_of(random() % size);
+    }
+  });
+  std::printf("%-28s %8.1f ns per query\n", "line k", found_lines / queries * 1e9);
+  std::printf("%-28s %8.1f ns per query\n", "line of offset",
+              found_offsets / queries * 1e9);
+
+  size_t const scans = 20;
+  double scanned = seconds([&] {
+    for (size_t i = 0; i < scans; ++i) {
+      size_t offset = random() % size;
+      checksum += std::count(log.begin(), log.begin() + offset, '\n');
+    }
+  });
+  std::printf("%-28s %8.1f us per query\n", "line of offset, by counting",
+              scanned / scans * 1e6);
+
+  // Indexes of parts of the log and of logs put together share what the
+  // index of the whole log already found.
+  size_t const slices = 1000;
+  double sliced = seconds([&] {
+    for (size_t i = 0; i < slices; ++i) {
+      size_t offset = random() % (size / 2);
+      checksum += lines_of_log->slice(offset, size / 4).line_count();
+    }
+  });
+  double joined = seconds([&] {
+    index_type twice = *lines_of_log + *lines_of_log;
+    checksum += twice.line_count();
+  });
+  std::printf("%-28s %8.1f us per slice\n", "indexing a quarter slice",
+              sliced / slices * 1e6);
+  std::printf("%-28s %8.1f ms\n", "indexing the log twice over", joined * 1e3);
+  delete lines_of_log;
+  return checksum == 0;
+}
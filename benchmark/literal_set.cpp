@@ -0,0 +1,85 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how classifying chains among a fixed list of header names
+// compares between trying the names one after the other and looking the chain
+// up in a literal set. Most of the chains are names from the list, the rest
+// are names that aren't.
+#include <chain/literal_set.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace chain::literals;
+
+constexpr auto headers = chain::make_literal_set(
+    "Accept"_chain, "Accept-Charset"_chain, "Accept-Encoding"_chain,
+    "Accept-Language"_chain, "Authorization"_chain, "Cache-Control"_chain,
+    "Connection"_chain, "Content-Encoding"_chain, "Content-Length"_chain,
+    "Content-Type"_chain, "Cookie"_chain, "Date"_chain, "ETag"_chain,
+    "Expect"_chain, "Expires"_chain, "From"_chain, "Host"_chain,
+    "If-Match"_chain, "If-Modified-Since"_chain, "If-None-Match"_chain,
+    "If-Range"_chain, "If-Unmodified-Since"_chain, "Last-Modified"_chain,
+    "Location"_chain, "Max-Forwards"_chain, "Origin"_chain, "Pragma"_chain,
+    "Proxy-Authorization"_chain, "Range"_chain, "Referer"_chain,
+    "Retry-After"_chain, "Server"_chain, "Set-Cookie"_chain, "TE"_chain,
+    "Trailer"_chain, "Transfer-Encoding"_chain, "Upgrade"_chain,
+    "User-Agent"_chain, "Vary"_chain, "Via"_chain, "Warning"_chain);
+
+template <class Function>
+double seconds(Function f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+  using chain::chain;
+
+  std::mt19937 random(42);
+  std::vector<chain> names;
+  for (int i = 0; i < 100000; ++i) {
+    auto const &literal = headers[random() % headers.size()];
+    std::string name(literal.data(), literal.size());
+    if (random() % 4 == 0) name += "-Extension";
+    names.push_back(chain(name));
+  }
+
+  size_t const rounds = 100;
+  size_t linear_found = 0, set_found = 0;
+  double linear = seconds([&] {
+    for (size_t r = 0; r < rounds; ++r) {
+      for (chain const &name : names) {
+        for (size_t i = 0; i < headers.size(); ++i) {
+          if (name == headers[i]) {
+            linear_found += i + 1;
+            break;
+          }
+        }
+      }
+    }
+  });
+  double hashed = seconds([&] {
+    for (size_t r = 0; r < rounds; ++r) {
+      for (chain const &name : names) {
+        size_t i = headers.find(name);
+        if (i != headers.npos) set_found += i + 1;
+      }
+    }
+  });
+  if (linear_found != set_found) {
+    std::printf("mismatch\n");
+    return 1;
+  }
+  size_t lookups = rounds * names.size();
+  std::printf("%zu literals, %zu lookups\n", headers.size(), lookups);
+  std::printf("linear      %8.1f ns per lookup\n", linear / lookups * 1e9);
+  std::printf("literal set %8.1f ns per lookup\n", hashed / lookups * 1e9);
+  return 0;
+}
@@ -0,0 +1,82 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how the parallel algorithms scale with the number of threads
+// on chains that are much larger than the caches. The size of the chain in
+// megabytes can be given as the first argument.
+#include <chain/parallel.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the function a few times and returns the best time in seconds.
+template <class Function>
+double best_of(int runs, Function f) {
+  double best = 1e30;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  using chain::parallel_count;
+  using chain::parallel_find;
+  using chain::parallel_transform;
+  using chain::parallel_reduce;
+  using chain::thread_pool;
+  using chain::chain;
+
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 128;
+  size_t size = megabytes << 20;
+  std::string contents(size, 'a');
+  for (size_t i = 0; i < size; i += 61) contents[i] = ' ';
+  contents[size - 1] = '!';
+  chain c(contents);
+  contents.clear();
+  contents.shrink_to_fit();
+
+  std::vector<unsigned> thread_counts;
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned t = 1; t < cores; t *= 2) thread_counts.push_back(t);
+  thread_counts.push_back(cores);
+
+  std::printf("%zu MB chain, %u cores\n", megabytes, cores);
+  std::printf("%8s %12s %12s %12s %12s\n", "threads", "count", "find",
+              "transform", "reduce");
+  double base[4] = {0, 0, 0, 0};
+  for (unsigned threads : thread_counts) {
+    thread_pool pool(threads);
+    volatile size_t sink = 0;
+    double times[4] = {
+      best_of(3, [&] { sink = parallel_count(c, ' ', pool); }),
+      best_of(3, [&] { sink = parallel_find(c, '!', pool); }),
+      best_of(3, [&] {
+        chain upper = parallel_transform(
+            c, [](char ch) { return char(ch & ~0x20); }, pool);
+      }),
+      best_of(3, [&] {
+        sink = parallel_reduce(
+            c, size_t(0), [](size_t l, size_t r) { return l + r; }, pool);
+      })
+    };
+    std::printf("%8u", threads);
+    for (int i = 0; i < 4; ++i) {
+      if (threads == thread_counts.front()) base[i] = times[i];
+      std::printf(" %6.0f MB/s %4.1fx", megabytes / times[i], base[i] / times[i]);
+    }
+    std::printf("\n");
+  }
+  return 0;
+}
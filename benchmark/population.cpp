@@ -0,0 +1,62 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how much memory a large population of small chains takes, on
+// top of the elements themselves. We keep a million chains of a few dozen
+// elements alive, first as they're constructed and then as concatenations of
+// slices of them with a few links each. The number of chains can be given as
+// the first argument.
+#include <chain/chain.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// The resident set size of the process right now, in kilobytes.
+long resident_kilobytes() {
+  long pages = 0, resident = 0;
+  if (FILE *statm = std::fopen("/proc/self/statm", "r")) {
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(statm);
+  }
+  return resident * (getpagesize() / 1024);
+}
+
+int main(int argc, char *argv[]) {
+  using chain::chain;
+
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  std::vector<std::string> contents;
+  for (int i = 0; i < 100; ++i) {
+    contents.push_back(std::string(20 + i % 40, char('a' + i % 26)));
+  }
+  size_t elements = 0;
+  for (size_t i = 0; i < count; ++i) elements += contents[i % 100].size();
+
+  std::vector<chain> constructed, concatenated;
+  constructed.reserve(count);
+  concatenated.reserve(count);
+  long before = resident_kilobytes();
+  for (size_t i = 0; i < count; ++i) {
+    constructed.push_back(chain(contents[i % 100]));
+  }
+  long after_constructed = resident_kilobytes();
+  for (size_t i = 0; i < count; ++i) {
+    chain const &c = constructed[i];
+    chain const &other = constructed[(i * 7919) % count];
+    concatenated.push_back(c.slice(0, 10) + other.slice(5, 10) + c.slice(10, 10));
+  }
+  long after_concatenated = resident_kilobytes();
+
+  std::printf("%zu chains, %zu elements\n", count, elements);
+  std::printf("%-14s %8ld KB, %6.1f bytes per chain besides the elements\n",
+              "constructed", after_constructed - before,
+              ((after_constructed - before) * 1024.0 - elements) / count);
+  std::printf("%-14s %8ld KB, %6.1f bytes per chain\n", "concatenated",
+              after_concatenated - after_constructed,
+              (after_concatenated - after_constructed) * 1024.0 / count);
+  return 0;
+}
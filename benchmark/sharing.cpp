@@ -0,0 +1,65 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how much comparing chains that were derived from the same
+// source gains from skipping the links they have in common. We compare each
+// derived chain against the source, and against a copy of the source with the
+// same contents in blocks of its own. The size of the source in megabytes can
+// be given as the first argument.
+#include <chain/chain.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+template <class Function>
+double best_of(int runs, Function f) {
+  double best = 1e30;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  using chain::chain;
+
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  size_t size = megabytes << 20;
+  std::string contents(size, 'a');
+  for (size_t i = 0; i < size; i += 97) contents[i] = char('a' + i % 26);
+  chain source(contents), unshared(contents);
+  contents.clear();
+
+  // A copy made of slices, an edit right in the middle, and an edit at the
+  // very end.
+  chain sliced = source.slice(0, size / 3) + source.slice(size / 3, size - size / 3);
+  chain middle = source.slice(0, size / 2) + chain("!") +
+                 source.slice(size / 2 + 1, size - size / 2 - 1);
+  chain end = source.slice(0, size - 1) + chain("!");
+
+  std::printf("%zu MB chains\n", megabytes);
+  std::printf("%-22s %14s %14s %10s\n", "", "shared", "unshared", "speedup");
+  struct {
+    char const *name;
+    chain const &derived;
+  } cases[] = {{"sliced copy", sliced},
+               {"edit in the middle", middle},
+               {"edit at the end", end}};
+  volatile int sink = 0;
+  for (auto const &c : cases) {
+    double shared = best_of(5, [&] { sink = source.compare(c.derived); });
+    double separate = best_of(5, [&] { sink = unshared.compare(c.derived); });
+    std::printf("%-22s %11.3f ms %11.3f ms %9.0fx\n", c.name, shared * 1e3,
+                separate * 1e3, separate / shared);
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see what splitting a large chain into lines costs next to
+// splitting a std::string into std::string_views, which copies nothing
+// either, and into std::strings, which copies every line. The size of the
+// log in megabytes can be given as the first argument.
+#include <chain/split.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+template <class Function>
+double seconds(Function f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+template <class Field, class Function>
+void split_string(std::string const &s, char delimiter, Function f) {
+  size_t start = 0;
+  for (size_t found = s.find(delimiter); found != std::string::npos;
+       found = s.find(delimiter, start)) {
+    f(Field(s.data() + start, found - start));
+    start = found + 1;
+  }
+  f(Field(s.data() + start, s.size() - start));
+}
+
+int main(int argc, char *argv[]) {
+  using chain::chain;
+
+  size_t const megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  size_t const size = megabytes << 20;
+  std::mt19937 random(42);
+  std::string log;
+  log.reserve(size + 200);
+  while (log.size() < size) {
+    size_t length = 20 + random() % 100;
+    for (size_t i = 0; i < length; ++i) log += char('a' + random() % 26);
+    log += '\n';
+  }
+  // The log is in pages the way one read a page at a time would be.
+  chain paged(log);
+
+  size_t lines = 0, elements = 0;
+  double chained = seconds([&] {
+    for (chain const &line : split(paged, '\n')) {
+      ++lines;
+      elements += line.size();
+    }
+  });
+  size_t view_lines = 0, view_elements = 0;
+  double viewed = seconds([&] {
+    split_string<std::string_view>(log, '\n', [&](std::string_view line) {
+      ++view_lines;
+      view_elements += line.size();
+    });
+  });
+  size_t copied_elements = 0;
+  double copied = seconds([&] {
+    split_string<std::string>(log, '\n', [&](std::string const &line) {
+      copied_elements += line.size();
+    });
+  });
+  if (lines != view_lines || elements != view_elements ||
+      elements != copied_elements) {
+    std::printf("mismatch\n");
+    return 1;
+  }
+  std::printf("splitting %zu MB into %zu lines\n", megabytes, lines);
+  std::printf("%-24s %8.2f ms %8.1f ns per line\n", "chain", chained * 1e3,
+              chained / lines * 1e9);
+  std::printf("%-24s %8.2f ms %8.1f ns per line\n", "std::string_view", viewed * 1e3,
+              viewed / lines * 1e9);
+  std::printf("%-24s %8.2f ms %8.1f ns per line\n", "std::string", copied * 1e3,
+              copied / lines * 1e9);
+  return 0;
+}
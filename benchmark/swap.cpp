@@ -0,0 +1,82 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to see how much swapping chains between stateful allocators that
+// don't compare equal costs. Tagged allocators can't adopt each other's blocks
+// so the contents have to be copied both ways, while pooled allocators share
+// their upstream memory and swap without copying anything.
+#include <chain/chain.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+template <class T>
+struct tagged_allocator {
+  typedef T value_type;
+  int tag;
+
+  tagged_allocator() : tag(0) {}
+  explicit tagged_allocator(int tag) : tag(tag) {}
+  template <class U>
+  tagged_allocator(tagged_allocator<U> const &other) : tag(other.tag) {}
+
+  T *allocate(std::size_t n) { return std::allocator<T>().allocate(n); }
+  void deallocate(T *p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+
+  bool operator==(tagged_allocator const &other) const { return tag == other.tag; }
+  bool operator!=(tagged_allocator const &other) const { return tag != other.tag; }
+};
+
+template <class T>
+struct pooled_allocator : tagged_allocator<T> {
+  pooled_allocator() {}
+  explicit pooled_allocator(int tag) : tagged_allocator<T>(tag) {}
+  template <class U>
+  pooled_allocator(pooled_allocator<U> const &other) : tagged_allocator<T>(other) {}
+};
+
+namespace chain {
+  template <class T>
+  struct allocator_adoption<pooled_allocator<T>> {
+    static bool can_adopt(pooled_allocator<T> const &, pooled_allocator<T> const &) {
+      return true;
+    }
+  };
+}  // namespace chain
+
+// Returns the best time in microseconds it takes to swap chains of the given
+// size with allocators that don't compare equal and swap them back.
+template <class Allocator>
+double swap_time(size_t size, int runs) {
+  typedef chain::chain_t<char, Allocator> chain_type;
+  Allocator first_allocator(1), second_allocator(2);
+  chain_type first(&first_allocator), second(&second_allocator);
+  std::basic_string<char, std::char_traits<char>, Allocator> contents(size, 'x');
+  chain_type(contents).swap(first);
+  chain_type(contents.substr(0, size / 2)).swap(second);
+  double best = 1e30;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    first.swap(second);
+    second.swap(first);
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  std::printf("%-10s %16s %16s\n", "size", "copying (us)", "adopting (us)");
+  for (size_t kilobytes : {4, 64, 1024, 16384, 131072}) {
+    int runs = kilobytes >= 16384 ? 3 : 50;
+    std::printf("%7zu KB %16.2f %16.2f\n", kilobytes,
+                swap_time<tagged_allocator<char>>(kilobytes << 10, runs),
+                swap_time<pooled_allocator<char>>(kilobytes << 10, runs));
+  }
+  return 0;
+}
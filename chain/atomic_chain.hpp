@@ -0,0 +1,240 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// atomic_chain.hpp
+//
+#ifndef CHAIN_ATOMIC_CHAIN_HPP
+#define CHAIN_ATOMIC_CHAIN_HPP
+
+#include <atomic>
+#include <memory>
+
+#include <chain/chain.hpp>
+
+namespace chain {
+
+  namespace detail {
+    // A hazard slot is where a thread says which links it's about to take a
+    // reference to, so that nobody lets go of the last reference to them in
+    // the meantime. Slots are never freed; a thread takes one the first time
+    // it needs it and gives it back for the next thread when it exits.
+    struct hazard_slot {
+      std::atomic<void const *> pointer;
+      std::atomic<bool> taken;
+      hazard_slot *next;
+
+      hazard_slot() : pointer(nullptr), taken(true), next(nullptr) {}
+    };
+
+    // Links that were replaced but may still be about to be referred to by a
+    // reader are retired instead of let go of, along with how to let go of
+    // them once no hazard slot names them. Writers make the node before they
+    // replace anything, so that retiring what they replaced can't fail.
+    struct retired_pointer {
+      void *pointer;
+      void (*reclaim)(void *);
+      retired_pointer *next;
+    };
+
+    class hazard_domain {
+      std::atomic<hazard_slot *> slots;
+      std::atomic<size_t> slot_count;
+      std::atomic<retired_pointer *> retired;
+      std::atomic<size_t> retired_count;
+
+      hazard_domain()
+      : slots(nullptr), slot_count(0), retired(nullptr), retired_count(0) {}
+
+      void push(retired_pointer *first, retired_pointer *last, size_t n) {
+        retired_pointer *head = retired.load();
+        do {
+          last->next = head;
+        } while (!retired.compare_exchange_weak(head, first));
+        retired_count.fetch_add(n);
+      }
+
+     public:
+      // The domain lives as long as the program does.
+      static hazard_domain &instance() {
+        static hazard_domain *domain = new hazard_domain();
+        return *domain;
+      }
+
+      hazard_slot *take() {
+        for (hazard_slot *s = slots.load(); s != nullptr; s = s->next) {
+          bool expected = false;
+          if (s->taken.compare_exchange_strong(expected, true)) return s;
+        }
+        hazard_slot *fresh = new hazard_slot();
+        hazard_slot *head = slots.load();
+        do {
+          fresh->next = head;
+        } while (!slots.compare_exchange_weak(head, fresh));
+        slot_count.fetch_add(1);
+        return fresh;
+      }
+
+      void give_back(hazard_slot *s) {
+        s->pointer.store(nullptr);
+        s->taken.store(false);
+      }
+
+      // Whether any thread is about to take a reference to p.
+      bool protects(void const *p) const {
+        for (hazard_slot *s = slots.load(); s != nullptr; s = s->next) {
+          if (s->pointer.load() == p) return true;
+        }
+        return false;
+      }
+
+      // Takes over the node and hands the pointer in it over to be reclaimed
+      // once no hazard slot names it. Retired pointers are looked at in
+      // batches, once there are a few more of them than there are slots, so
+      // that each scan of the slots lets go of most of what it looks at.
+      void retire(retired_pointer *r) noexcept {
+        push(r, r, 1);
+        if (retired_count.load() >= 2 * slot_count.load() + 16) scan();
+      }
+
+      // Reclaims every retired pointer that no hazard slot names, putting the
+      // rest back for a later scan. Scans can run on several threads at once,
+      // since each one works on the pointers it took off the list.
+      void scan() {
+        retired_pointer *taken = retired.exchange(nullptr);
+        retired_pointer *kept = nullptr, *kept_last = nullptr;
+        size_t looked_at = 0, still_protected = 0;
+        while (taken != nullptr) {
+          retired_pointer *following = taken->next;
+          ++looked_at;
+          if (protects(taken->pointer)) {
+            taken->next = kept;
+            if (kept == nullptr) kept_last = taken;
+            kept = taken;
+            ++still_protected;
+          } else {
+            taken->reclaim(taken->pointer);
+            delete taken;
+          }
+          taken = following;
+        }
+        retired_count.fetch_sub(looked_at);
+        if (kept != nullptr) push(kept, kept_last, still_protected);
+      }
+
+      size_t retired_size() const { return retired_count.load(); }
+    };
+
+    // The hazard slot of the calling thread.
+    inline hazard_slot &thread_hazard() {
+      struct holder {
+        hazard_slot *slot;
+        holder() : slot(hazard_domain::instance().take()) {}
+        ~holder() { hazard_domain::instance().give_back(slot); }
+      };
+      static thread_local holder h;
+      return *h.slot;
+    }
+  }  // namespace detail
+
+  // An atomic chain is a chain that one thread can replace while others are
+  // reading it, the way a configuration or a routing table is shared. Loading
+  // gives a chain of its own to the reader, which is a snapshot that stays the
+  // same however many times the atomic chain is replaced afterwards.
+  //
+  // Neither readers nor writers ever wait for each other. Readers say which
+  // links they're about to take a reference to in a hazard slot of their own,
+  // check that the links are still the current ones, and take the reference.
+  // Writers swap the links in with a single atomic exchange, and retire the
+  // reference the atomic chain held to the links they replaced instead of
+  // letting go of it: retired links are let go of in batches, by whichever
+  // writer retires enough of them, once no reader is about to take a
+  // reference to them. A reader that stalls in the middle of a load only
+  // holds back the links it named, never a writer. Writers do allocate, from
+  // the free store, the node they retire the replaced links with; they do so
+  // before the exchange, so a store that fails leaves the atomic chain as it
+  // was.
+  //
+  //   chain::atomic_chain<chain::chain> routes(chain::chain("..."));
+  //   chain::chain snapshot = routes.load();  // on any thread
+  //   routes.store(chain::chain("..."));       // on another
+  //
+  // Chains that are stored are kept with the atomic chain's allocator, which
+  // is the allocator of the chain it was constructed with; chains with other
+  // allocators get copied the same way assigning them to a chain would.
+  //
+  // Only the atomic chain itself is safe to share this way. Building chains
+  // from contents fills the last page shared by every chain with the same
+  // element and allocator types, which isn't synchronized, so only one thread
+  // at a time may build chains that way; readers that only copy, slice and
+  // concatenate the snapshots they load, or build chains with writers of
+  // exclusive pages, can do so on any number of threads.
+  template <class Chain>
+  class atomic_chain;
+
+  template <class Element, class Allocator>
+  class atomic_chain<chain_t<Element, Allocator>> {
+    typedef chain_t<Element, Allocator> chain_type;
+    typedef detail::block_links<Element, Allocator> links_type;
+
+   public:
+    atomic_chain() : allocator_(nullptr), links_(nullptr) {
+      chain_type defaulted;
+      allocator_ = detail::chain_access::allocator(defaulted);
+    }
+
+    explicit atomic_chain(chain_type desired)
+    : allocator_(detail::chain_access::allocator(desired))
+    , links_(detail::chain_access::take(desired)) {}
+
+    atomic_chain(atomic_chain const &) = delete;
+    atomic_chain &operator=(atomic_chain const &) = delete;
+
+    ~atomic_chain() { links_type::release(links_.load()); }
+
+    chain_type load() const {
+      detail::hazard_slot &hazard = detail::thread_hazard();
+      links_type *links = links_.load();
+      for (;;) {
+        hazard.pointer.store(links);
+        links_type *current = links_.load();
+        if (current == links) break;
+        links = current;
+      }
+      links_type::acquire(links);
+      hazard.pointer.store(nullptr, std::memory_order_release);
+      return detail::chain_access::make(allocator_, links);
+    }
+
+    // Replaces the chain, giving back the one it replaced.
+    chain_type exchange(chain_type desired) {
+      chain_type ours(allocator_);
+      ours = std::move(desired);
+      std::unique_ptr<detail::retired_pointer> retired(
+          new detail::retired_pointer{nullptr, &release_links, nullptr});
+      links_type *previous = links_.exchange(detail::chain_access::take(ours));
+      if (previous == nullptr) return chain_type(allocator_);
+      // Readers that got to the previous links before the exchange may still
+      // be about to take a reference to them, so the reference we held stays
+      // around until they're done and the caller gets one of its own.
+      links_type::acquire(previous);
+      retired->pointer = previous;
+      detail::hazard_domain::instance().retire(retired.release());
+      return detail::chain_access::make(allocator_, previous);
+    }
+
+    void store(chain_type desired) { exchange(std::move(desired)); }
+
+   private:
+    static void release_links(void *links) {
+      links_type::release(static_cast<links_type *>(links));
+    }
+
+    Allocator *allocator_;
+    std::atomic<links_type *> links_;
+  };
+
+}  // namespace chain
+
+#endif  // CHAIN_ATOMIC_CHAIN_HPP
@@ -22,12 +22,53 @@
 #else
 #define assert(x)
 #endif
+// tuple -- because links are (block, offset, length) triples.
+#include <tuple>
+// vector -- because chains can adopt the buffers of vectors.
+#include <vector>
+// compare -- for the three-way comparison operator, where it's supported.
+#if defined(__cpp_impl_three_way_comparison) && \
+    __cpp_impl_three_way_comparison >= 201907L
+#include <compare>
+#endif
+
+// The blocks and the links that refer to them are implementation details that
+// the chain is built on top of.
+#include <chain/detail/block_links.hpp>
+// The UTF-8 validation used when constructing validated chains.
+#include <chain/detail/utf.hpp>
+// The copy engine used when chains need their own copy of another's links.
+#include <chain/detail/bulk_copy.hpp>
 
 // We define a namespace for which the whole library implementation will live
 // in. We claim the chain namespace to make it obvious that chain types and
 // operations live in this namespace.
 namespace chain {
 
+  namespace detail {
+    struct chain_access;
+  }  // namespace detail
+
+  // Chains of 8-bit elements can validate their contents as UTF-8 while they
+  // are being constructed by passing this tag along with the contents.
+  struct validate_utf8_t {};
+  constexpr validate_utf8_t validate_utf8 = validate_utf8_t();
+
+  // Blocks remember the allocator they came from and go back to it when the
+  // last chain referring to them lets go, so a chain can hold on to blocks from
+  // an allocator other than its own as long as that allocator outlives it. By
+  // default we only let a chain do that with allocators that compare equal to
+  // its own. Allocators whose instances are different but draw from a common
+  // upstream resource that outlives them all can specialize this so that
+  // swapping chains between them doesn't need to copy anything.
+  template <class Allocator>
+  struct allocator_adoption {
+    // Whether a chain using adopter can take over blocks allocated by owner.
+    static bool can_adopt(Allocator const &adopter, Allocator const &owner) {
+      return adopter == owner;
+    }
+  };
+
   // The heart of the whole library is a type that acts as a container for an
   // immutable chain. We liken the process of creating a chain to forging steel
   // links which are then treated and let to cool concatenated together to form
@@ -53,20 +94,76 @@ namespace chain {
     template <class Traits>
     chain_t(std::basic_string<Element, Traits, Allocator> const &string);
 
+    // Both of the above can also check that the contents are well-formed UTF-8
+    // in the same pass that copies them into the chain. The chain points to
+    // nothing if the contents turn out to be malformed.
+    template <int N>
+    chain_t(Element const (&literal)[N], validate_utf8_t);
+
+    template <class Traits>
+    chain_t(std::basic_string<Element, Traits, Allocator> const &string,
+            validate_utf8_t);
+
     // We also support default construction that takes a pointer to an
     // allocator. This is almost equivalent to a default constructed chain where
     // there is a difference between a chain that points to nothing and a chain
     // that is empty.
     explicit chain_t(Allocator *allocator);
 
+    // Chains can also be constructed from strings with a given allocator. The
+    // allocator has to outlive the chain and all the chains that share its
+    // blocks.
+    template <class Traits>
+    chain_t(std::basic_string<Element, Traits, Allocator> const &string,
+            Allocator *allocator);
+
+    // Chains can also adopt buffers that already hold the elements instead of
+    // copying them, which is worth it for large buffers. The chain takes over
+    // the buffer along with whatever owns it, and the buffer is let go of when
+    // the last chain referring to any of its elements goes away. Buffers can
+    // come with a deleter, which is called with the buffer then, in a
+    // std::unique_ptr, or in a std::vector.
+    template <class Deleter>
+    chain_t(Element *buffer, size_t length, Deleter deleter);
+
+    template <class Deleter>
+    chain_t(Element *buffer, size_t length, Deleter deleter,
+            Allocator *allocator);
+
+    template <class Deleter>
+    chain_t(std::unique_ptr<Element[], Deleter> buffer, size_t length);
+
+    template <class Deleter>
+    chain_t(std::unique_ptr<Element[], Deleter> buffer, size_t length,
+            Allocator *allocator);
+
+    template <class VectorAllocator>
+    explicit chain_t(std::vector<Element, VectorAllocator> &&buffer);
+
+    template <class VectorAllocator>
+    chain_t(std::vector<Element, VectorAllocator> &&buffer,
+            Allocator *allocator);
+
     // We also allow chains to copy from already constructed chains. We require
     // and enforce a noexcept guarantee to make sure we can rely on copy
     // operations to not throw.
     chain_t(chain_t const &other) noexcept;
 
+    // Moving a chain takes its links over without touching their reference
+    // count, and leaves the chain that was moved from pointing to nothing with
+    // the same allocator as before. This is what returning chains and growing
+    // containers of chains use.
+    chain_t(chain_t &&other) noexcept;
+
+    // Chains let go of their links when they're destroyed.
+    ~chain_t();
+
     // Now we can start implementing assignment since we now already have a
     // defined copy constructor. We also want to enforce that assignment is a
-    // copy and swap and that this does not throw exceptions.
+    // copy and swap and that this does not throw exceptions. Since the
+    // argument is moved into when assigning from a temporary or a moved chain,
+    // this is also the move assignment, which then doesn't touch any reference
+    // counts when the allocators compare equal.
     chain_t& operator=(chain_t rhs) noexcept {
       rhs.swap(*this);
       return *this;
@@ -86,49 +183,35 @@ namespace chain {
       // Here we try and enforce the invariant that we do not throw even if and
       // especially since we have a different allocator from the object we're
       // swapping with.
-      if (*other.allocator_ == *allocator_) {
+      typedef allocator_adoption<Allocator> adoption;
+      if (*other.allocator_ == *allocator_ ||
+          (adoption::can_adopt(*allocator_, *other.allocator_) &&
+           adoption::can_adopt(*other.allocator_, *allocator_))) {
         // Most of the time we're not using stateful allocators and we're just
         // going to actually swap some pointers around. We make this the then
         // case of the if as a hint to the compiler that we're almost pretty
         // sure that this will happen most of the time in most user's code.
         std::swap(this->links_, other.links_);
       } else {
-        // Here we then need to create a new chain using this object's allocator
-        // so that we make sure we're doing the correct thing by preserving this
-        // object's invariants. We also create a temporary for the other chain
-        // so that we can properly copy the elements using the other chain's
-        // special cloning copy constructor.
-        chain_t defaulted_this(this->allocator_);
-        chain_t defaulted_that(other.allocator_);
-        chain_t temporary_this(this->allocator_);
-        chain_t temporary_that(other.allocator_);
-        // Because we have the temporaries set up correctly at this time as
-        // defaulted chains, we can now start the actual copy of links using
-        // different allocators that don't compare equal. This is really
-        // important that both operations actually do not throw and both have to
-        // succeed before we do any mutation of this object and the other
-        // object.
-        temporary_this.copy_links(other);
-        temporary_that.copy_links(*this);
-        // Now we check whether both operations actually succeeded completely.
-        if (temporary_this == defaulted_this || temporary_that == defaulted_that) {
-          // We got here because the copying of links has actually failed for
-          // either case. Here we cannot do anything but actually not do
-          // anything. We can then signal the calling function that the swap
-          // didn't succeed.
+        // Here we need copies of both sides' elements made with the other
+        // side's allocator, each in a single block of its own. This is really
+        // important that both copies succeed before we do any mutation of this
+        // object and the other object, and that neither of them throws.
+        links_type *copied_this = nullptr, *copied_that = nullptr;
+        if (!copy_links(allocator_, other.links_, copied_this)) return false;
+        if (!copy_links(other.allocator_, links_, copied_that)) {
+          links_type::release(copied_this);
           return false;
         }
         // We've passed the failure test and now we're ready to actually make
-        // sure that this object will inherit the temporary_this' links in a
-        // non-throwing manner while the other will inherit the temporary_that's
-        // links.
-        this->links_ = temporary_this.links_;
-        other.links_ = temporary_that.links_;
-        // WHen we get to this point we're pretty confident that we now have the
-        // elements copied and that the swap has actually done what it's
-        // supposed to do.
-        return true;
+        // sure that this object will inherit the copy of the other's links in a
+        // non-throwing manner while the other will inherit the copy of ours.
+        links_type::release(links_);
+        links_type::release(other.links_);
+        links_ = copied_this;
+        other.links_ = copied_that;
       }
+      return true;
     }
 
     // We then move on to defining semantics of various relational opertors on
@@ -146,19 +229,493 @@ namespace chain {
     // We then provide the inverse of the equivalence relation operator.
     bool operator!=(chain_t const &other) const;
 
+    // Chains know how many elements they have, as well as whether they point to
+    // nothing, without having to look at their blocks. A chain that points to
+    // nothing has no elements, the same as an empty chain.
+    size_t size() const { return links_ == nullptr ? 0 : links_->size(); }
+    bool empty() const { return size() == 0; }
+    bool null() const { return links_ == nullptr; }
+
+    // A slice of a chain is a new chain made of length elements starting at
+    // offset, which shares the blocks of this chain instead of copying them.
+    // The slice has to be within the chain. Slicing a chain that points to
+    // nothing gives a chain that points to nothing.
+    chain_t slice(size_t offset, size_t length) const;
+
+    // Edits give new chains made of the parts of this chain that the edit
+    // leaves alone and the chain that goes in, sharing the blocks of both, so
+    // an edit takes time in the number of links and not of elements. Replacing
+    // takes out length elements starting at position and puts the other chain
+    // in their place. The range has to be within the chain. Like with
+    // concatenation, chains that point to nothing are treated as empty unless
+    // they both do.
+    chain_t replace(size_t position, size_t length, chain_t const &other) const;
+
+    chain_t insert(size_t position, chain_t const &other) const {
+      return replace(position, 0, other);
+    }
+
+    chain_t erase(size_t position, size_t length) const {
+      return replace(position, length, chain_t(allocator_));
+    }
+
+    // Replacing all of the needle gives a new chain where every occurrence of
+    // the needle, from the front and without overlapping, is replaced by the
+    // other chain. We look for the needle link by link without flattening the
+    // chain, so occurrences that span blocks are found too. The parts between
+    // occurrences keep referring to the blocks of this chain and every
+    // occurrence refers to the blocks of the replacement, so the new chain
+    // only costs a link or two per occurrence however long this chain is. An
+    // empty needle occurs nowhere, and a chain with no occurrences gives back
+    // a copy of itself.
+    chain_t replace_all(chain_t const &needle, chain_t const &replacement) const;
+
+    // Chains are also ordered lexicographically by their elements so that
+    // they can be sorted and used as keys in ordered containers. The compare
+    // member returns a negative number, zero or a positive number depending on
+    // whether this chain is less than, equivalent to or greater than the other
+    // one. A chain that points to nothing comes before every other chain,
+    // including empty ones.
+    int compare(chain_t const &other) const;
+
+    bool operator<(chain_t const &other) const { return compare(other) < 0; }
+    bool operator<=(chain_t const &other) const { return compare(other) <= 0; }
+    bool operator>(chain_t const &other) const { return compare(other) > 0; }
+    bool operator>=(chain_t const &other) const { return compare(other) >= 0; }
+
+#if defined(__cpp_impl_three_way_comparison) && \
+    __cpp_impl_three_way_comparison >= 201907L
+    // Compilers that support it get the three-way comparison operator too.
+    std::strong_ordering operator<=>(chain_t const &other) const {
+      return compare(other) <=> 0;
+    }
+#endif
+
    private:
+    typedef detail::block_links<Element, Allocator> links_type;
+
     Allocator *allocator_;
-    // TODO(dberris): make this happen!
-    void *links_;
-
-    // The cloning constructor (or actually, cloning function) does an explicit
-    // copy of the data in the links using the current object's associated
-    // allocator and making sure there are no errors in the whole operation. It
-    // gracefully backs out when it cannot copy all the links and cleans up
-    // after itself.
-    void copy_links(chain_t const &other) noexcept;
+    // The links are shared between copies of a chain. A chain that points to
+    // nothing has no links at all, while an empty chain has links that refer
+    // to no blocks.
+    links_type *links_;
+
+    friend struct detail::chain_access;
+
+    template <class E, class A>
+    friend chain_t<E, A> operator+(chain_t<E, A> const &l, chain_t<E, A> const &r);
+
+    // Copies the contents in. The links are made before the contents are
+    // copied, so that failing to make them doesn't leave the references to
+    // the blocks the contents went into behind.
+    void make_links(Element const *contents, size_t length);
+
+    // Copies the contents in while validating them as UTF-8, leaving the chain
+    // pointing to nothing if they're not well-formed.
+    void validate_links(Element const *contents, size_t length);
+
+    // Hands the owner of an adopted buffer over to the blocks that refer to
+    // the elements it holds.
+    template <class Owner>
+    void adopt(Owner &owner, size_t length);
+
+    template <class Deleter>
+    static Element const *buffer_of(std::unique_ptr<Element[], Deleter> const &b) {
+      return b.get();
+    }
+
+    template <class VectorAllocator>
+    static Element const *buffer_of(std::vector<Element, VectorAllocator> const &b) {
+      return b.data();
+    }
+
+    // Chains that aren't given an allocator share a default one.
+    static Allocator *default_allocator() {
+      static Allocator allocator;
+      return &allocator;
+    }
+
+    // Chains built by the library internals start from links that have already
+    // been put together, taking over the reference to them.
+    chain_t(Allocator *allocator, links_type *links) noexcept
+    : allocator_(allocator), links_(links) {}
+
+    // The cloning function does an explicit copy of the data in the links
+    // using the given allocator and making sure there are no errors in the
+    // whole operation. Copying links that point to nothing gives links that
+    // point to nothing. It returns whether it succeeded, and gracefully backs
+    // out and cleans up after itself when it cannot copy all the links.
+    static bool copy_links(Allocator *allocator, links_type const *links,
+                           links_type *&copied) noexcept;
   };
 
+  namespace detail {
+    // The library internals build chains directly out of links and walk the
+    // links of existing chains. We keep that access in one place.
+    struct chain_access {
+      template <class Element, class Allocator>
+      static block_links<Element, Allocator> const *
+      links(chain_t<Element, Allocator> const &c) {
+        return c.links_;
+      }
+
+      template <class Element, class Allocator>
+      static Allocator *allocator(chain_t<Element, Allocator> const &c) {
+        return c.allocator_;
+      }
+
+      template <class Element, class Allocator>
+      static chain_t<Element, Allocator>
+      make(Allocator *allocator, block_links<Element, Allocator> *links) {
+        return chain_t<Element, Allocator>(allocator, links);
+      }
+
+      // Takes the reference to the links away from the chain, leaving it
+      // pointing to nothing.
+      template <class Element, class Allocator>
+      static block_links<Element, Allocator> *take(chain_t<Element, Allocator> &c) {
+        block_links<Element, Allocator> *links = c.links_;
+        c.links_ = nullptr;
+        return links;
+      }
+    };
+  }  // namespace detail
+
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator>::chain_t()
+  : allocator_(default_allocator()), links_(nullptr) {}
+
+  template <class Element, class Allocator>
+  template <int N>
+  chain_t<Element, Allocator>::chain_t(Element const (&literal)[N])
+  : allocator_(default_allocator()), links_(nullptr) {
+    // The literal comes with its terminating null element which isn't part of
+    // the contents.
+    make_links(literal, N > 0 ? N - 1 : 0);
+  }
+
+  template <class Element, class Allocator>
+  template <class Traits>
+  chain_t<Element, Allocator>::chain_t(
+      std::basic_string<Element, Traits, Allocator> const &string)
+  : allocator_(default_allocator()), links_(nullptr) {
+    make_links(string.data(), string.size());
+  }
+
+  template <class Element, class Allocator>
+  template <int N>
+  chain_t<Element, Allocator>::chain_t(Element const (&literal)[N],
+                                       validate_utf8_t)
+  : allocator_(default_allocator()), links_(nullptr) {
+    validate_links(literal, N > 0 ? N - 1 : 0);
+  }
+
+  template <class Element, class Allocator>
+  template <class Traits>
+  chain_t<Element, Allocator>::chain_t(
+      std::basic_string<Element, Traits, Allocator> const &string,
+      validate_utf8_t)
+  : allocator_(default_allocator()), links_(nullptr) {
+    validate_links(string.data(), string.size());
+  }
+
+  template <class Element, class Allocator>
+  void chain_t<Element, Allocator>::make_links(Element const *contents,
+                                               size_t length) {
+    links_type *links = links_type::make(allocator_);
+    try {
+      links->append(
+          links_type::block_type::get_block(contents, length, allocator_));
+    } catch (...) {
+      links_type::release(links);
+      throw;
+    }
+    links_ = links;
+  }
+
+  template <class Element, class Allocator>
+  void chain_t<Element, Allocator>::validate_links(Element const *contents,
+                                                   size_t length) {
+    static_assert(sizeof(Element) == 1, "Only 8-bit chains hold UTF-8.");
+    detail::utf8_validating_copy<Element> copier;
+    typename links_type::block_offset_length_tuple t;
+    links_type *links = links_type::make(allocator_);
+    try {
+      if (!links_type::block_type::get_block(contents, length, allocator_,
+                                             copier, t)) {
+        links_type::release(links);
+        return;
+      }
+      links->append(std::move(t));
+    } catch (...) {
+      links_type::release(links);
+      throw;
+    }
+    links_ = links;
+  }
+
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator>::chain_t(Allocator *allocator)
+  : allocator_(allocator), links_(nullptr) {
+    assert(allocator_ != nullptr);
+  }
+
+  template <class Element, class Allocator>
+  template <class Traits>
+  chain_t<Element, Allocator>::chain_t(
+      std::basic_string<Element, Traits, Allocator> const &string,
+      Allocator *allocator)
+  : allocator_(allocator), links_(nullptr) {
+    assert(allocator_ != nullptr);
+    make_links(string.data(), string.size());
+  }
+
+  template <class Element, class Allocator>
+  template <class Deleter>
+  chain_t<Element, Allocator>::chain_t(Element *buffer, size_t length,
+                                       Deleter deleter)
+  : chain_t(std::unique_ptr<Element[], Deleter>(buffer, std::move(deleter)),
+            length, default_allocator()) {}
+
+  template <class Element, class Allocator>
+  template <class Deleter>
+  chain_t<Element, Allocator>::chain_t(Element *buffer, size_t length,
+                                       Deleter deleter, Allocator *allocator)
+  : chain_t(std::unique_ptr<Element[], Deleter>(buffer, std::move(deleter)),
+            length, allocator) {}
+
+  template <class Element, class Allocator>
+  template <class Deleter>
+  chain_t<Element, Allocator>::chain_t(
+      std::unique_ptr<Element[], Deleter> buffer, size_t length)
+  : chain_t(std::move(buffer), length, default_allocator()) {}
+
+  template <class Element, class Allocator>
+  template <class Deleter>
+  chain_t<Element, Allocator>::chain_t(
+      std::unique_ptr<Element[], Deleter> buffer, size_t length,
+      Allocator *allocator)
+  : allocator_(allocator), links_(nullptr) {
+    assert(allocator_ != nullptr);
+    adopt(buffer, length);
+  }
+
+  template <class Element, class Allocator>
+  template <class VectorAllocator>
+  chain_t<Element, Allocator>::chain_t(
+      std::vector<Element, VectorAllocator> &&buffer)
+  : chain_t(std::move(buffer), default_allocator()) {}
+
+  template <class Element, class Allocator>
+  template <class VectorAllocator>
+  chain_t<Element, Allocator>::chain_t(
+      std::vector<Element, VectorAllocator> &&buffer, Allocator *allocator)
+  : allocator_(allocator), links_(nullptr) {
+    assert(allocator_ != nullptr);
+    size_t length = buffer.size();
+    adopt(buffer, length);
+  }
+
+  template <class Element, class Allocator>
+  template <class Owner>
+  void chain_t<Element, Allocator>::adopt(Owner &owner, size_t length) {
+    // If we can't make room for the owner, the buffer stays with the caller's
+    // owner and goes away with it. From then on it's ours to dispose of until
+    // the blocks take it over, and theirs afterwards: making the blocks
+    // disposes of the owner if it fails, and letting go of the links lets go
+    // of whatever blocks made it in.
+    typedef detail::owned_buffer<Owner, Allocator> owned_type;
+    owned_type *owned = owned_type::make(allocator_, std::move(owner));
+    links_type *links;
+    try {
+      links = links_type::make(allocator_);
+    } catch (...) {
+      owned->dispose();
+      throw;
+    }
+    try {
+      links->append(links_type::block_type::get_external_block(
+          buffer_of(owned->get()), length, allocator_, owned));
+    } catch (...) {
+      links_type::release(links);
+      throw;
+    }
+    links_ = links;
+  }
+
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator>::chain_t(chain_t const &other) noexcept
+  : allocator_(other.allocator_), links_(other.links_) {
+    links_type::acquire(links_);
+  }
+
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator>::chain_t(chain_t &&other) noexcept
+  : allocator_(other.allocator_), links_(other.links_) {
+    other.links_ = nullptr;
+  }
+
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator>::~chain_t() {
+    links_type::release(links_);
+  }
+
+  template <class Element, class Allocator>
+  bool chain_t<Element, Allocator>::operator==(chain_t const &other) const {
+    if (links_ == other.links_) return true;
+    if (links_ == nullptr || other.links_ == nullptr) return false;
+    return links_->equal(*other.links_);
+  }
+
+  template <class Element, class Allocator>
+  bool chain_t<Element, Allocator>::operator!=(chain_t const &other) const {
+    return !(*this == other);
+  }
+
+  template <class Element, class Allocator>
+  int chain_t<Element, Allocator>::compare(chain_t const &other) const {
+    if (links_ == other.links_) return 0;
+    if (links_ == nullptr) return -1;
+    if (other.links_ == nullptr) return 1;
+    return links_->compare(*other.links_);
+  }
+
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator>
+  chain_t<Element, Allocator>::slice(size_t offset, size_t length) const {
+    if (links_ == nullptr) return chain_t(allocator_);
+    links_type *sliced = links_type::make(allocator_, *links_);
+    sliced->slice(offset, length);
+    return chain_t(allocator_, sliced);
+  }
+
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator>
+  chain_t<Element, Allocator>::replace(size_t position, size_t length,
+                                       chain_t const &other) const {
+    assert(position + length <= size() && "Invalid position and length.");
+    if (links_ == nullptr && other.links_ == nullptr) return chain_t(allocator_);
+    links_type *edited = links_type::make(allocator_);
+    try {
+      size_t count = links_ == nullptr ? 0 : links_->link_count();
+      size_t inserted = other.links_ == nullptr ? 0 : other.links_->link_count();
+      edited->reserve(count + inserted + 1);
+      if (links_ != nullptr) edited->extend(*links_, 0, position);
+      if (other.links_ != nullptr) edited->extend(*other.links_);
+      if (links_ != nullptr) {
+        size_t rest = position + length;
+        edited->extend(*links_, rest, links_->size() - rest);
+      }
+    } catch (...) {
+      links_type::release(edited);
+      throw;
+    }
+    return chain_t(allocator_, edited);
+  }
+
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator>
+  chain_t<Element, Allocator>::replace_all(chain_t const &needle,
+                                           chain_t const &replacement) const {
+    typedef typename links_type::const_iterator iterator;
+    if (links_ == nullptr || needle.empty()) return *this;
+    std::vector<Element> pattern;
+    pattern.reserve(needle.size());
+    for (auto const &link : *needle.links_) {
+      pattern.insert(pattern.end(), link.data(), link.data() + link.length);
+    }
+    iterator const end = links_->end();
+    // Positions are a link and an offset into it, which is only ever at the
+    // end of a link for the last one.
+    auto settle = [end](iterator &l, size_t &offset) {
+      while (l != end && offset == l->length) {
+        ++l;
+        offset = 0;
+      }
+    };
+    // Whether the pattern starts at the position, moving it past the pattern
+    // if it does.
+    auto matches = [&](iterator &l, size_t &offset) {
+      size_t matched = 0;
+      while (matched < pattern.size()) {
+        if (l == end) return false;
+        size_t part = std::min<size_t>(l->length - offset, pattern.size() - matched);
+        if (detail::compare_elements(l->data() + offset, pattern.data() + matched,
+                                     part)) {
+          return false;
+        }
+        matched += part;
+        offset += part;
+        settle(l, offset);
+      }
+      return true;
+    };
+    links_type *replaced = links_type::make(allocator_);
+    // Keeps the elements of the link from offset up to before.
+    auto keep = [replaced](iterator l, size_t offset, size_t before) {
+      if (offset == before) return;
+      links_type::block_type::acquire(l->target);
+      replaced->push_link(l->target, l->offset + offset, before - offset);
+    };
+    size_t occurrences = 0;
+    try {
+      iterator kept = links_->begin(), l = kept;
+      size_t kept_offset = 0, offset = 0;
+      settle(l, offset);
+      while (l != end) {
+        offset += detail::find_element(l->data() + offset, l->length - offset,
+                                       pattern.front());
+        if (offset == l->length) {
+          settle(l, offset);
+          continue;
+        }
+        iterator after = l;
+        size_t after_offset = offset;
+        if (!matches(after, after_offset)) {
+          ++offset;
+          settle(l, offset);
+          continue;
+        }
+        for (; kept != l; ++kept, kept_offset = 0) {
+          keep(kept, kept_offset, kept->length);
+        }
+        keep(l, kept_offset, offset);
+        if (replacement.links_ != nullptr) replaced->extend(*replacement.links_);
+        ++occurrences;
+        kept = l = after;
+        kept_offset = offset = after_offset;
+      }
+      for (; kept != end; ++kept, kept_offset = 0) {
+        keep(kept, kept_offset, kept->length);
+      }
+    } catch (...) {
+      links_type::release(replaced);
+      throw;
+    }
+    if (occurrences == 0) {
+      links_type::release(replaced);
+      return *this;
+    }
+    return chain_t(allocator_, replaced);
+  }
+
+  template <class Element, class Allocator>
+  bool chain_t<Element, Allocator>::copy_links(Allocator *allocator,
+                                               links_type const *links,
+                                               links_type *&copied) noexcept {
+    copied = nullptr;
+    if (links == nullptr) return true;
+    try {
+      detail::block_writer<Element, Allocator> writer(allocator);
+      detail::bulk_copy(writer, *links);
+      copied = writer.finish();
+      return true;
+    } catch (...) {
+      // The writer lets go of whatever it managed to copy.
+      return false;
+    }
+  }
+
 
   // For convenience purposes we're defining a few aliases to commonly used
   // chain types.
@@ -185,6 +742,84 @@ namespace chain {
     l.swap(r);
   }
 
+  // Concatenating two chains gives a new chain that refers to the blocks of
+  // both, one after the other, without copying any of their elements. Chains
+  // that point to nothing are treated as empty, unless they both do.
+  template <class Element, class Allocator>
+  chain_t<Element, Allocator> operator+(chain_t<Element, Allocator> const &l,
+                                        chain_t<Element, Allocator> const &r) {
+    typedef detail::block_links<Element, Allocator> links_type;
+    if (l.links_ == nullptr) return r;
+    if (r.links_ == nullptr) return l;
+    links_type *combined = links_type::make(l.allocator_, *l.links_);
+    try {
+      combined->extend(*r.links_);
+    } catch (...) {
+      links_type::release(combined);
+      throw;
+    }
+    return chain_t<Element, Allocator>(l.allocator_, combined);
+  }
+
+  // Pages that no chain refers to anymore are kept around for the chains that
+  // come after them, up to a high watermark of pages per chain type. Once the
+  // pool goes over that, it gives pages back to the allocator until it's down
+  // to its low watermark. Only chains with stateless allocators pool their
+  // pages. The pool starts out keeping between 64 and 256 pages.
+  //
+  //   chain::page_pool<chain::chain>::set_watermarks(0, 1024);
+  //   chain::page_pool<chain::chain>::trim();
+  template <class Chain>
+  struct page_pool;
+
+  template <class Element, class Allocator>
+  struct page_pool<chain_t<Element, Allocator>> {
+    typedef detail::block_pool<Element, Allocator> pool_type;
+
+    // The number of pages in the pool.
+    static size_t size() { return pool_type::instance().size(); }
+
+    // A high watermark of zero turns the pool off.
+    static void set_watermarks(size_t low, size_t high) {
+      pool_type::instance().set_watermarks(low, high);
+    }
+
+    // Gives all but keep of the pooled pages back to the allocator.
+    static void trim(size_t keep = 0) { pool_type::instance().trim(keep); }
+  };
+
+  // Pages the pool doesn't keep, including the ones it lets go of when it
+  // goes over its high watermark or is trimmed, are given back to the
+  // allocator by whichever thread lets go of them, unless deferred reclamation
+  // is turned on by giving it a limit. Those pages are then queued up until they're reclaimed
+  // in a batch, either by calling reclaim at a point where the program can
+  // afford to or by a background_reclaimer, up to the limit in bytes: letting
+  // go of a page that would go over the limit reclaims the whole batch right
+  // there. Like the pool, only chains with stateless allocators defer giving
+  // their pages back, and deferred reclamation starts out turned off.
+  //
+  //   chain::deferred_reclamation<chain::chain>::set_limit(64 << 20);
+  //   ...
+  //   chain::deferred_reclamation<chain::chain>::reclaim();
+  template <class Chain>
+  struct deferred_reclamation;
+
+  template <class Element, class Allocator>
+  struct deferred_reclamation<chain_t<Element, Allocator>> {
+    typedef detail::block_reclaimer<Element, Allocator> reclaimer_type;
+
+    // The number of bytes waiting to be given back.
+    static size_t size() { return reclaimer_type::instance().size(); }
+
+    // A limit of zero turns deferred reclamation off, giving back everything
+    // that was deferred.
+    static void set_limit(size_t bytes) {
+      reclaimer_type::instance().set_limit(bytes);
+    }
+
+    static void reclaim() { reclaimer_type::instance().reclaim(); }
+  };
+
 }  // namespace chain
 
 #endif  // CHAIN_HPP
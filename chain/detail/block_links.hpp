@@ -6,163 +6,1364 @@
 #ifndef DETAIL_BLOCK_LINKS_HPP
 #define DETAIL_BLOCK_LINKS_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <unistd.h>
+
+#include <chain/detail/mismatch.hpp>
+
 namespace chain {
 
 namespace detail {
 
 template <class CharT, class AllocatorT>
-class block {
+class block_links;
+
+// The properties we keep track of for the contents of a page. Only contents
+// that were checked on the way in keep them; anything else written into the
+// page clears them.
+enum block_flags {
+  ascii_only = 1,  // Every element is in the ASCII range.
+  valid_utf8 = 2   // The contents were validated as UTF-8 when copied in.
+};
+
+template <class CharT, class AllocatorT>
+class block_writer;
+
+template <class CharT, class AllocatorT>
+class block_pool;
+
+template <class CharT, class AllocatorT>
+class block_reclaimer;
+
+// Most allocators are only asked for the pages; the bookkeeping that goes with
+// them comes from the free store, and the last page is shared by every chain
+// that uses the same stateless allocator. Arena allocators, whose memory all goes away at
+// once when the arena does, need everything a chain allocates to come from the
+// arena instead, and can't have a page outlive the chains that refer to it
+// because it's kept around for the next chain. Arena allocators specialize this
+// to derive from std::true_type.
+template <class AllocatorT>
+struct arena_allocator : std::false_type {};
+
+// Stateless allocators are the only ones any instance of which can deallocate
+// what any other allocated, so they're the only ones that can share the last
+// page: it's kept around after the chains that wrote into it are gone, along
+// with the instances of the allocator they used. Every other allocator gets
+// blocks of its own, the way arenas do.
+template <class AllocatorT>
+struct stateless_allocator
+    : std::integral_constant<bool,
+                             std::is_empty<AllocatorT>::value &&
+                                 std::is_default_constructible<AllocatorT>::value &&
+                                 !arena_allocator<AllocatorT>::value> {};
+
+// The allocator the bookkeeping for chains using AllocatorT comes from.
+template <class AllocatorT, class T, bool = arena_allocator<AllocatorT>::value>
+struct internal_allocator {
+  typedef std::allocator<T> type;
+  static type make(AllocatorT *) { return type(); }
+};
+
+template <class AllocatorT, class T>
+struct internal_allocator<AllocatorT, T, true> {
+  typedef typename std::allocator_traits<AllocatorT>::template rebind_alloc<T> type;
+  static type make(AllocatorT *allocator) { return type(*allocator); }
+};
+
+// Chains and their copies can be let go of on different threads, so the
+// reference counts of the links, the blocks, and the owners of adopted buffers
+// are atomic. Taking a reference needs no ordering; letting go of the last one
+// has to see everything the other threads did before they let go of theirs.
+typedef std::atomic<size_t> reference_count;
+
+inline void count_reference(reference_count &count) {
+  count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Returns whether that was the last reference.
+inline bool drop_reference(reference_count &count) {
+  return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+// Chains can adopt buffers that were filled somewhere else instead of copying
+// them into pages. Whatever owns such a buffer -- a std::unique_ptr, a
+// std::vector, or a pointer and a deleter -- is kept alive by the blocks that
+// refer to the buffer, and the last of them to go away disposes of the owner
+// and with it the buffer.
+class external_owner {
+  reference_count refcount;
+
+  template <class CharT, class AllocatorT>
+  friend class block;
+
+ protected:
+  external_owner() : refcount(0) {}
+  ~external_owner() {}
+
+ public:
+  virtual void dispose() noexcept = 0;
+};
+
+template <class Owner, class AllocatorT>
+class owned_buffer : public external_owner {
+  typedef internal_allocator<AllocatorT, owned_buffer> allocator_type;
+
   AllocatorT *allocator;
-  CharT *page;
+  Owner owner;
+
+  owned_buffer(AllocatorT *allocator, Owner &&owner)
+  : allocator(allocator), owner(std::move(owner)) {}
+
+ public:
+  // The owner comes from the same place as the rest of the bookkeeping.
+  static owned_buffer *make(AllocatorT *allocator, Owner &&owner) {
+    typename allocator_type::type a = allocator_type::make(allocator);
+    owned_buffer *fresh = a.allocate(1);
+    try {
+      ::new (static_cast<void *>(fresh)) owned_buffer(allocator, std::move(owner));
+    } catch (...) {
+      a.deallocate(fresh, 1);
+      throw;
+    }
+    return fresh;
+  }
+
+  Owner &get() { return owner; }
+
+  void dispose() noexcept override {
+    typename allocator_type::type a = allocator_type::make(allocator);
+    this->~owned_buffer();
+    a.deallocate(this, 1);
+  }
+};
+
+// A block is a page of elements allocated through the chain's allocator. Blocks
+// are filled once, front to back, and then never change -- many chains can then
+// refer to parts of the same block. Blocks made for contents whose size is known
+// up front may be bigger than a page so that they take a single allocation. All
+// the live blocks for a given element and allocator type are kept in a
+// doubly-linked list in the order they were allocated, and the last one in that
+// list is the one we're still filling.
+//
+// A block and its page are a single allocation: the block sits in the first
+// cache line of the allocation, with the fields that get touched whenever a
+// chain is built or let go of at the front, and the page starts at the next
+// cache line. Getting at the elements a link refers to then only ever misses
+// the cache on the page itself.
+//
+// Blocks for adopted buffers have no page of their own. What sits where the
+// page would be instead says where their elements are and what owns them.
+template <class CharT, class AllocatorT>
+class block {
+  reference_count refcount;
   size_t filled;
+  size_t capacity;
+  // What we know about everything that's been written into the page so far.
+  // An empty page vacuously has all the properties.
+  unsigned char flags;
+  // How far into the allocation the block starts so that it's aligned to a
+  // cache line.
+  unsigned char padding;
+  // Whether the elements are in an adopted buffer rather than the page.
+  bool external;
+  AllocatorT *allocator;
   block<CharT, AllocatorT> *next, *previous;
-  size_t refcount;
 
-  block(AllocatorT *allocator, CharT *page, size_t filled,
-        block<CharT, AllocatorT> *next, block<CharT, AllocatorT> *previous,
-        size_t refcount)
-  : allocator(allocator), page(page), filled(filled), next(next)
-  , previous(previous), refcount(refcount)
+  friend class block_links<CharT, AllocatorT>;
+  friend class block_writer<CharT, AllocatorT>;
+  friend class block_pool<CharT, AllocatorT>;
+  friend class block_reclaimer<CharT, AllocatorT>;
+
+  static size_t const cache_line = 64;
+
+  block(AllocatorT *allocator, size_t capacity, unsigned char padding,
+        block<CharT, AllocatorT> *previous)
+  : refcount(1), filled(0), capacity(capacity), flags(ascii_only | valid_utf8)
+  , padding(padding), external(false), allocator(allocator), next(nullptr)
+  , previous(previous)
   {}
 
+  struct external_page {
+    CharT const *elements;
+    external_owner *owner;
+  };
+
+  // Blocks for adopted buffers come from the same place as the rest of the
+  // bookkeeping, with just enough room after them for the external page.
+  typedef internal_allocator<AllocatorT, char> external_allocator;
+
+  static size_t external_size() { return header_size() + sizeof(external_page); }
+
+  external_page *external_contents() {
+    return reinterpret_cast<external_page *>(page());
+  }
+
+  // The block takes up whole cache lines ahead of its page.
+  static size_t header_size() {
+    return (sizeof(block) + cache_line - 1) / cache_line * cache_line;
+  }
+
+  // The number of elements we allocate for a block with room for capacity
+  // elements: enough for the block, for aligning it, and for the page.
+  static size_t allocation_size(size_t capacity) {
+    return capacity + (header_size() + cache_line - 1 + sizeof(CharT) - 1) /
+                      sizeof(CharT);
+  }
+
+  CharT *page() {
+    return reinterpret_cast<CharT *>(reinterpret_cast<char *>(this) + header_size());
+  }
+
+  block(block const &) = delete;
+  block &operator=(block const &) = delete;
+
+  // The last block is the one new contents get written into. The list holds a
+  // reference to it so that it stays alive even if no chain refers to it yet.
+  // Filling it isn't synchronized, so only one thread at a time may build
+  // chains from contents for a given element and allocator type; threads that
+  // need to build chains at the same time use writers with exclusive pages.
+  static block<CharT, AllocatorT> *&last_block() {
+    static block<CharT, AllocatorT> *last = nullptr;
+    return last;
+  }
+
+  // Allocates a fresh page, or room for capacity elements if that's given, and
+  // the block for it, with a single reference that belongs to the caller.
+  static block<CharT, AllocatorT> *new_block(AllocatorT *allocator,
+                                             block<CharT, AllocatorT> *previous,
+                                             size_t capacity = page_size()) {
+    if (capacity == page_size()) {
+      block<CharT, AllocatorT> *recycled =
+          block_pool<CharT, AllocatorT>::instance().take();
+      if (recycled != nullptr) {
+        recycled->allocator = allocator;
+        recycled->previous = previous;
+        return recycled;
+      }
+    }
+    char *allocation =
+        reinterpret_cast<char *>(allocator->allocate(allocation_size(capacity)));
+    size_t padding =
+        (cache_line - reinterpret_cast<uintptr_t>(allocation) % cache_line) %
+        cache_line;
+    return ::new (static_cast<void *>(allocation + padding))
+        block<CharT, AllocatorT>(allocator, capacity,
+                                 static_cast<unsigned char>(padding), previous);
+  }
+
+  // Returns the last block if it still has room and was allocated with the
+  // same allocator, otherwise allocates a fresh page and makes that the last
+  // block instead. Only stateless allocators get here.
+  static block<CharT, AllocatorT> *open_block(AllocatorT *allocator) {
+    block<CharT, AllocatorT> *current = last_block();
+    if (current != nullptr && current->allocator == allocator &&
+        current->filled < current->capacity) {
+      return current;
+    }
+    block<CharT, AllocatorT> *fresh = new_block(allocator, current);
+    last_block() = fresh;
+    if (current != nullptr) {
+      current->next = fresh;
+      // The list no longer needs to keep the previous last block alive.
+      release(current);
+    }
+    return fresh;
+  }
+
  public:
+  // Blocks that aren't pages are at most this many bytes, which also keeps the
+  // offsets and lengths of links within a block small. Allocators tend to hand
+  // anything bigger straight to the operating system and back, which then has
+  // to supply fresh pages every time.
+  static size_t largest_block() {
+    return std::max<size_t>(page_size(), (size_t(8) << 20) / sizeof(CharT));
+  }
+
+  // The number of elements that fit in a page. We size pages to match the
+  // system's page size in bytes.
+  static size_t page_size() {
+    static size_t const size =
+        std::max<size_t>(1, getpagesize() / sizeof(CharT));
+    assert(size && "We need a valid page size that's greater than 0.");
+    return size;
+  }
+
+  CharT const *data() const {
+    char const *contents = reinterpret_cast<char const *>(this) + header_size();
+    if (external) {
+      return reinterpret_cast<external_page const *>(contents)->elements;
+    }
+    return reinterpret_cast<CharT const *>(contents);
+  }
+
+  bool ascii() const { return flags & ascii_only; }
+  bool utf8() const { return flags & valid_utf8; }
+
+  // The plain copy used when constructing chains doesn't look at the contents,
+  // so we can't claim anything about them afterwards.
+  struct plain_copy {
+    bool operator()(CharT const *contents, size_t length, CharT *destination,
+                    unsigned char &segment_flags) {
+      std::copy(contents, contents + length, destination);
+      segment_flags = 0;
+      return true;
+    }
+
+    bool finish() const { return true; }
+  };
+
+  static void acquire(block<CharT, AllocatorT> *b) {
+    count_reference(b->refcount);
+  }
+
+  static void release(block<CharT, AllocatorT> *b) {
+    assert(b->refcount && "Releasing an unreferenced block!");
+    if (drop_reference(b->refcount) &&
+        !block_pool<CharT, AllocatorT>::instance().put(b) &&
+        !block_reclaimer<CharT, AllocatorT>::instance().defer(b)) {
+      destroy(b);
+    }
+  }
+
+ private:
+  static void destroy(block<CharT, AllocatorT> *b) {
+    AllocatorT *allocator = b->allocator;
+    if (b->external) {
+      external_owner *owner = b->external_contents()->owner;
+      typename external_allocator::type a = external_allocator::make(allocator);
+      b->~block();
+      a.deallocate(reinterpret_cast<char *>(b), external_size());
+      if (drop_reference(owner->refcount)) owner->dispose();
+      return;
+    }
+    CharT *allocation =
+        reinterpret_cast<CharT *>(reinterpret_cast<char *>(b) - b->padding);
+    size_t size = allocation_size(b->capacity);
+    b->~block();
+    deallocate(allocator, allocation, size, stateless_allocator<AllocatorT>());
+  }
+
+  // The last page can outlive the instance of a stateless allocator it came
+  // from, so we give those back through one of our own.
+  static void deallocate(AllocatorT *, CharT *allocation, size_t size,
+                         std::true_type) {
+    AllocatorT allocator;
+    allocator.deallocate(allocation, size);
+  }
+
+  static void deallocate(AllocatorT *allocator, CharT *allocation, size_t size,
+                         std::false_type) {
+    allocator->deallocate(allocation, size);
+  }
+
+  // Blocks can go away on any thread that lets go of the last chain referring
+  // to them, including two neighbours at once, so taking them out of the list
+  // is done under a lock of its own.
+  static std::mutex &list_mutex() {
+    static std::mutex *mutex = new std::mutex();
+    return *mutex;
+  }
+
+  // Takes the block out of the list of live blocks.
+  void unlink() {
+    std::lock_guard<std::mutex> lock(list_mutex());
+    if (previous != nullptr) {
+      previous->next = next;
+    }
+    if (next != nullptr) {
+      next->previous = previous;
+    }
+    next = previous = nullptr;
+  }
+
+  // Releases the references to the consecutive blocks from first up to but not
+  // including last.
+  static void release_range(block<CharT, AllocatorT> *first,
+                            block<CharT, AllocatorT> *last) {
+    for (block<CharT, AllocatorT> *b = first; b != last;) {
+      block<CharT, AllocatorT> *following = b->next;
+      release(b);
+      b = following;
+    }
+  }
+
+ public:
+  // Copies the contents into as many blocks as necessary, starting at the first
+  // available element of the last block. The returned tuple holds the first
+  // block, the offset into that block, and the total length of the contents;
+  // the blocks the contents span are consecutive in the list of blocks and the
+  // tuple owns one reference to each of them.
   static std::tuple<block<CharT, AllocatorT> *, size_t, size_t>
-  get_block(string_ref<CharT> && contents, AllocatorT *allocator) {
-    static block<CharT, AllocatorT> root{allocator, nullptr, 0, nullptr, nullptr, 1};
-    static block<CharT, AllocatorT> *last_block = &root;
-    static size_t const page_size = getpagesize();
-    assert(page_size && "We need a valid page size that's greater than 0.");
-    // TODO(dberris): Make this thread-safe or document as not thread-safe.
+  get_block(CharT const *contents, size_t length, AllocatorT *allocator) {
+    std::tuple<block<CharT, AllocatorT> *, size_t, size_t> result;
+    plain_copy copier;
+    get_block(contents, length, allocator, copier, result);
+    return result;
+  }
+
+  // The copier does the actual copying of each segment that goes into a page,
+  // and gets the chance to look at the contents on the way through. It tells us
+  // what it found out about the segment so we can keep the page's flags up to
+  // date, and it can reject the contents altogether, in which case we give
+  // back the references we've taken and return false. The pages keep whatever
+  // was copied into them until then, but nothing refers to it.
+  template <class Copier>
+  static bool get_block(CharT const *contents, size_t length,
+                        AllocatorT *allocator, Copier &copier,
+                        std::tuple<block<CharT, AllocatorT> *, size_t, size_t> &result) {
     // TODO(dberris): Explore memoization or hashing of contents to conserve blocks.
-    // Compute how many blocks you need given the length of the contents and
-    // then build the list of blocks appropriately returned.
-    block<CharT, AllocatorT> *current_block = last_block;
-    while (current_block->filled == page_size && current_block->next != nullptr) {
-      current_block = current_block->next;
+    result = std::tuple<block<CharT, AllocatorT> *, size_t, size_t>{nullptr, 0, 0};
+    if (length == 0) return copier.finish();
+    if (!stateless_allocator<AllocatorT>::value) {
+      return get_exclusive_block(contents, length, allocator, copier, result);
     }
+    block<CharT, AllocatorT> *current_block = open_block(allocator);
     block<CharT, AllocatorT> *returned_block = current_block;
     size_t offset = current_block->filled;
-    string_ref<CharT>::const_iterator begin = contents.begin(),
-        end = contents.end();
-    for (int numblocks = (contents.size() / page_size) 
-         + (contents.size() % page_size > 0);
-         numblocks > 0; --numblocks) {
-      string_ref<CharT>::const_iterator segment_end = begin;
-      std::advance(segment_end, std::min(page_size, std::distance(begin, end)));
-      current_block->page = allocator.allocate(page_size);
-      std::copy(begin, segment_end, current_block->page);
-      begin = segment_end;
-      current_block->filled += std::distance(begin, segment_end);
-      current_block->next = new (std::nothrow) block<CharT, AllocatorT>{
-        allocator, nullptr, 0, nullptr, current_block, 1};
-      current_block = current_block->next;
-    }
-    last_block = current_block;
-    return {returned_block, offset, contents.size()};
+    size_t remaining = length;
+    bool accepted = true;
+    try {
+      for (;;) {
+        size_t segment =
+            std::min(remaining, current_block->capacity - current_block->filled);
+        unsigned char segment_flags = 0;
+        if (!copier(contents, segment,
+                    current_block->page() + current_block->filled,
+                    segment_flags)) {
+          accepted = false;
+          break;
+        }
+        current_block->filled += segment;
+        current_block->flags &= segment_flags;
+        contents += segment;
+        remaining -= segment;
+        count_reference(current_block->refcount);
+        if (!remaining) break;
+        current_block = open_block(allocator);
+      }
+    } catch (...) {
+      // We only get here when allocating a page fails, in which case we give
+      // back the references we've taken so far.
+      release_range(returned_block, current_block->next);
+      throw;
+    }
+    if (accepted && copier.finish()) {
+      result = std::tuple<block<CharT, AllocatorT> *, size_t, size_t>{
+        returned_block, offset, length};
+      return true;
+    }
+    // When the copier rejects the last bit of the contents we've already taken
+    // a reference to the last block as well.
+    if (accepted) current_block = current_block->next;
+    release_range(returned_block, current_block);
+    return false;
   }
 
+ private:
+  // Contents going into an arena, or using any other allocator that isn't
+  // stateless, get blocks of their own that are just big enough for them,
+  // which nothing else will write into. Contents that are too big for a single
+  // block go into several, linked to each other so that the tuple can span
+  // them.
+  template <class Copier>
+  static bool get_exclusive_block(
+      CharT const *contents, size_t length, AllocatorT *allocator, Copier &copier,
+      std::tuple<block<CharT, AllocatorT> *, size_t, size_t> &result) {
+    block<CharT, AllocatorT> *first = nullptr, *last = nullptr;
+    bool accepted = true;
+    try {
+      for (size_t remaining = length; remaining && accepted;) {
+        size_t segment = std::min(remaining, largest_block());
+        block<CharT, AllocatorT> *fresh = new_block(allocator, last, segment);
+        if (last != nullptr) last->next = fresh;
+        if (first == nullptr) first = fresh;
+        last = fresh;
+        unsigned char segment_flags = 0;
+        accepted = copier(contents, segment, fresh->page(), segment_flags);
+        fresh->filled = segment;
+        fresh->flags &= segment_flags;
+        contents += segment;
+        remaining -= segment;
+      }
+      accepted = accepted && copier.finish();
+    } catch (...) {
+      release_range(first, nullptr);
+      throw;
+    }
+    if (!accepted) {
+      release_range(first, nullptr);
+      return false;
+    }
+    result = std::tuple<block<CharT, AllocatorT> *, size_t, size_t>{first, 0, length};
+    return true;
+  }
+
+ public:
+  // Refers to the length elements of an adopted buffer, which the owner keeps
+  // alive, without copying them. Buffers too big for a single block get
+  // several, linked to each other the same way arena blocks are, that all
+  // share the owner. The returned tuple is the same as what get_block(...)
+  // returns. The blocks take over the owner; if we can't make them, or there
+  // are no elements to refer to, it's disposed of right away.
+  static std::tuple<block<CharT, AllocatorT> *, size_t, size_t>
+  get_external_block(CharT const *elements, size_t length,
+                     AllocatorT *allocator, external_owner *owner) {
+    block<CharT, AllocatorT> *first = nullptr, *last = nullptr;
+    // We hold on to the owner ourselves until all the blocks are made.
+    count_reference(owner->refcount);
+    try {
+      for (size_t remaining = length; remaining;) {
+        size_t segment = std::min(remaining, largest_block());
+        typename external_allocator::type a = external_allocator::make(allocator);
+        block<CharT, AllocatorT> *fresh = ::new (static_cast<void *>(
+            a.allocate(external_size()))) block<CharT, AllocatorT>(
+                allocator, segment, 0, last);
+        fresh->external = true;
+        fresh->filled = segment;
+        fresh->flags = 0;
+        *fresh->external_contents() = external_page{elements, owner};
+        count_reference(owner->refcount);
+        if (last != nullptr) last->next = fresh;
+        if (first == nullptr) first = fresh;
+        last = fresh;
+        elements += segment;
+        remaining -= segment;
+      }
+    } catch (...) {
+      release_range(first, nullptr);
+      if (drop_reference(owner->refcount)) owner->dispose();
+      throw;
+    }
+    if (drop_reference(owner->refcount)) owner->dispose();
+    return std::tuple<block<CharT, AllocatorT> *, size_t, size_t>{first, 0, length};
+  }
+
+ private:
   ~block() {
     assert(refcount == 0 && "Deleting a referenced block!");
-    allocator->destroy(page);
-    allocator->deallocate(page);
-    page = nullptr;
-    if (previous != nullptr) {
-      previous->next = next;
+    unlink();
+  }
+};
+
+
+// Blocks that nothing refers to anymore are kept in a pool, page and all, so
+// that new blocks can reuse them instead of going back to the allocator every
+// time. The pool keeps at most its high watermark of blocks; once it would go
+// over, it lets go of blocks until it's down to its low watermark so that
+// churning right at the limit doesn't allocate and deallocate every time.
+//
+// Only page-sized blocks from stateless allocators that aren't arenas go in
+// the pool: any instance of those can deallocate what any other allocated, and
+// nothing is lost when one of them goes away. Writers with exclusive pages
+// allocate blocks on several threads at once, so the pool has a lock of its
+// own.
+template <class CharT, class AllocatorT>
+class block_pool {
+  typedef block<CharT, AllocatorT> block_type;
+
+  std::mutex mutex;
+  // The pooled blocks, linked through their next pointers.
+  block_type *pooled;
+  size_t count, low_watermark, high_watermark;
+
+  block_pool() : pooled(nullptr), count(0), low_watermark(64), high_watermark(256) {}
+
+  typedef stateless_allocator<AllocatorT> poolable;
+
+  // Detaches all but keep of the pooled blocks, which the caller destroys once
+  // we're no longer holding the lock.
+  block_type *detach(size_t keep) {
+    block_type *detached = nullptr;
+    for (; count > keep; --count) {
+      block_type *b = pooled;
+      pooled = b->next;
+      b->next = detached;
+      detached = b;
     }
-    if (next != nullptr) {
-      next->previous = previous;
+    return detached;
+  }
+
+  // Blocks we let go of are deferred like any other when deferred
+  // reclamation is on, so that going over the high watermark doesn't give a
+  // whole batch of pages back on the thread that let go of the last one.
+  static void destroy(block_type *detached) {
+    destroy(block_reclaimer<CharT, AllocatorT>::instance().defer_all(detached),
+            poolable());
+  }
+
+  static void destroy(block_type *, std::false_type) {}
+
+  // Blocks in the pool don't remember which instance of the allocator they
+  // came from, so we give them back through one of our own.
+  static void destroy(block_type *detached, std::true_type) {
+    AllocatorT allocator;
+    while (detached != nullptr) {
+      block_type *following = detached->next;
+      detached->next = nullptr;
+      detached->allocator = &allocator;
+      block_type::destroy(detached);
+      detached = following;
+    }
+  }
+
+ public:
+  // The pool lives as long as the program does, blocks and all.
+  static block_pool &instance() {
+    static block_pool *pool = new block_pool();
+    return *pool;
+  }
+
+  // Takes a block out of the pool, ready to be filled and with a single
+  // reference that belongs to the caller, or returns nullptr if the pool is
+  // empty.
+  block_type *take() {
+    if (!poolable::value) return nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    block_type *b = pooled;
+    if (b == nullptr) return nullptr;
+    pooled = b->next;
+    --count;
+    b->next = nullptr;
+    b->filled = 0;
+    b->refcount.store(1, std::memory_order_relaxed);
+    b->flags = ascii_only | valid_utf8;
+    return b;
+  }
+
+  // Offers a block that nothing refers to anymore to the pool, and returns
+  // whether the pool kept it.
+  bool put(block_type *b) {
+    if (!poolable::value || b->external ||
+        b->capacity != block_type::page_size()) {
+      return false;
     }
+    block_type *detached = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (high_watermark == 0) return false;
+      b->unlink();
+      b->allocator = nullptr;
+      b->next = pooled;
+      pooled = b;
+      if (++count > high_watermark) detached = detach(low_watermark);
+    }
+    destroy(detached);
+    return true;
+  }
+
+  // Lets go of all but keep of the pooled blocks.
+  void trim(size_t keep) {
+    block_type *detached;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      detached = detach(keep);
+    }
+    destroy(detached);
+  }
+
+  // Sets the watermarks, letting go of blocks if there are too many now. A
+  // high watermark of zero turns the pool off.
+  void set_watermarks(size_t low, size_t high) {
+    assert(low <= high && "The low watermark can't be above the high one.");
+    block_type *detached = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      low_watermark = low;
+      high_watermark = high;
+      if (count > high) detached = detach(low);
+    }
+    destroy(detached);
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
   }
 };
 
 
+// Blocks that the pool doesn't keep are normally given back to the allocator
+// by whichever thread lets go of them last. With deferred reclamation turned
+// on they're queued up instead, and given back in batches whenever someone
+// reclaims them: at a point where the program knows it can afford to, or on a
+// thread of its own. Nothing can get at a block once its last reference is
+// gone, so any point is safe to reclaim at; all we have to bound is how much
+// memory waits to be given back. A release that would take the queue over
+// the limit reclaims the whole batch right there.
+//
+// Like the pool, only blocks from stateless allocators that aren't arenas are
+// deferred, so that they can be given back through an allocator of our own
+// long after the one they came from is gone.
 template <class CharT, class AllocatorT>
-class block_links {
-  typedef tuple<block<CharT, AllocatorT>*, size_t, size_t>> block_offset_length_tuple;
-  std::deque<block_offset_length_tuple> links;
+class block_reclaimer {
+  typedef block<CharT, AllocatorT> block_type;
+
+  std::mutex mutex;
+  std::condition_variable pending;
+  // The deferred blocks, linked through their next pointers.
+  block_type *deferred;
+  size_t deferred_bytes;
+  // The limit is only ever changed with the lock held, but releases check it
+  // without taking the lock so that they don't pay for it while deferred
+  // reclamation is off.
+  std::atomic<size_t> limit;
+  // How many times anyone waiting to reclaim was woken up.
+  size_t wakeups;
+
+  block_reclaimer()
+  : deferred(nullptr), deferred_bytes(0), limit(0), wakeups(0) {}
+
+  typedef stateless_allocator<AllocatorT> deferrable;
+
+  static size_t bytes(block_type *b) {
+    return block_type::allocation_size(b->capacity) * sizeof(CharT);
+  }
+
+  block_type *detach() {
+    block_type *detached = deferred;
+    deferred = nullptr;
+    deferred_bytes = 0;
+    return detached;
+  }
+
+  static void destroy(block_type *detached) { destroy(detached, deferrable()); }
+
+  static void destroy(block_type *, std::false_type) {}
+
+  static void destroy(block_type *detached, std::true_type) {
+    AllocatorT allocator;
+    while (detached != nullptr) {
+      block_type *following = detached->next;
+      detached->next = nullptr;
+      detached->allocator = &allocator;
+      block_type::destroy(detached);
+      detached = following;
+    }
+  }
+
  public:
-  explicit block_links(block_offset_length_tuple &&t)
-  : links{} {
-    // Let's determine the correct lengths for each block-offset-length given the
-    // results from get_block(...).
-    size_t &total_length = get<2>(t);
-    size_t &initial_block_offset = get<1>(t);
-    block<CharT, AllocatorT> *&current_block;
-    while (current_block != nullptr && total_length) {
-      links.push_back({
-        current_block,
-        initial_block_offset,
-        total_length -= current_block->filled - initial_block_offset
+  // The reclaimer lives as long as the program does.
+  static block_reclaimer &instance() {
+    static block_reclaimer *reclaimer = new block_reclaimer();
+    return *reclaimer;
+  }
+
+  // Queues up a block that nothing refers to anymore, and returns whether it
+  // was deferred.
+  bool defer(block_type *b) {
+    if (!deferrable::value || limit.load(std::memory_order_relaxed) == 0) {
+      return false;
+    }
+    block_type *detached = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (limit == 0) return false;
+      b->unlink();
+      b->next = deferred;
+      deferred = b;
+      deferred_bytes += bytes(b);
+      if (deferred_bytes > limit) {
+        detached = detach();
+      } else if (deferred_bytes > limit / 2) {
+        pending.notify_all();
+      }
+    }
+    destroy(detached);
+    return true;
+  }
+
+  // Queues up a list of blocks, linked through their next pointers, that are
+  // already out of the list of live blocks, the way the pool lets go of them.
+  // Returns the blocks that the caller still has to give back: none of them
+  // if they were deferred, all of them if deferred reclamation is off, and
+  // everything that was waiting along with them if they took the queue over
+  // the limit.
+  block_type *defer_all(block_type *detached) {
+    if (detached == nullptr || !deferrable::value ||
+        limit.load(std::memory_order_relaxed) == 0) {
+      return detached;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (limit == 0) return detached;
+    while (detached != nullptr) {
+      block_type *b = detached;
+      detached = b->next;
+      b->next = deferred;
+      deferred = b;
+      deferred_bytes += bytes(b);
+    }
+    if (deferred_bytes > limit) return detach();
+    if (deferred_bytes > limit / 2) pending.notify_all();
+    return nullptr;
+  }
+
+  // Gives back everything that's been deferred so far.
+  void reclaim() {
+    block_type *detached;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      detached = detach();
+    }
+    destroy(detached);
+  }
+
+  // Waits until more than half the limit is deferred, the timeout passes, or
+  // we're woken up, then gives back everything that's been deferred.
+  void reclaim_after(std::chrono::steady_clock::duration timeout) {
+    block_type *detached;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      size_t seen = wakeups;
+      pending.wait_for(lock, timeout, [this, seen] {
+        return wakeups != seen || (limit && deferred_bytes > limit / 2);
       });
-      initial_block_offset = 0;  // We then always refer to the beginning of the next block.
-      current_block = current_block->next;
+      detached = detach();
+    }
+    destroy(detached);
+  }
+
+  // Bounds the bytes that wait to be given back. A limit of zero turns
+  // deferred reclamation off and gives back everything that was deferred.
+  void set_limit(size_t bytes) {
+    block_type *detached = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      limit = bytes;
+      if (deferred_bytes > limit) detached = detach();
+    }
+    destroy(detached);
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return deferred_bytes;
+  }
+
+  // Wakes up anyone waiting to reclaim.
+  void wake() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++wakeups;
+    pending.notify_all();
+  }
+};
+
+
+// A link refers to length elements starting at offset in a block. No block
+// holds more elements than fit in 32 bits, so a link fits in 16 bytes.
+template <class CharT, class AllocatorT>
+struct packed_link {
+  block<CharT, AllocatorT> *target;
+  uint32_t offset;
+  uint32_t length;
+
+  CharT const *data() const { return target->data() + offset; }
+
+  bool operator==(packed_link const &other) const {
+    return target == other.target && offset == other.offset &&
+           length == other.length;
+  }
+};
+
+
+#ifdef CHAIN_COUNT_REFERENCES
+// Tests can count how many times the reference counts of links change by
+// defining CHAIN_COUNT_REFERENCES before including any of the headers.
+inline size_t &link_reference_traffic() {
+  static size_t traffic = 0;
+  return traffic;
+}
+#endif
+
+// The block links are the (block, offset, length) triples that make up a chain
+// in order. Links are immutable once built and are shared between copies of a
+// chain, so they carry their own reference count. They're allocated the same
+// way as the blocks, so we only ever make them through make.
+//
+// Most chains only have a link or two, so the first few links are kept right
+// in the block links; only chains with more than that need room for their
+// links elsewhere.
+template <class CharT, class AllocatorT>
+class block_links {
+ public:
+  typedef block<CharT, AllocatorT> block_type;
+  typedef std::tuple<block_type *, size_t, size_t> block_offset_length_tuple;
+  typedef packed_link<CharT, AllocatorT> link_type;
+  typedef link_type const *const_iterator;
+
+ private:
+  typedef internal_allocator<AllocatorT, link_type> link_allocator;
+  typedef internal_allocator<AllocatorT, block_links> links_allocator;
+
+  static size_t const inline_links = 2;
+
+  AllocatorT *allocator;
+  reference_count refcount;
+  // The total number of elements all the links refer to.
+  size_t total;
+  link_type *links;
+  uint32_t count, reserved;
+  link_type inline_storage[inline_links];
+
+  explicit block_links(AllocatorT *allocator)
+  : allocator(allocator), refcount(1), total(0), links(inline_storage), count(0)
+  , reserved(inline_links) {}
+
+  // Copying the links gives a new set of links, not shared with any chain yet,
+  // that refers to the same blocks.
+  block_links(AllocatorT *allocator, block_links const &other)
+  : allocator(allocator), refcount(1), total(0), links(inline_storage), count(0)
+  , reserved(inline_links) {
+    reserve(other.count);
+    std::copy(other.links, other.links + other.count, links);
+    count = other.count;
+    total = other.total;
+    for (link_type const &l : *this) block_type::acquire(l.target);
+  }
+
+  block_links(block_links const &) = delete;
+  block_links &operator=(block_links const &) = delete;
+
+
+  void free_links() {
+    if (links != inline_storage) {
+      typename link_allocator::type a = link_allocator::make(allocator);
+      a.deallocate(links, reserved);
+    }
+  }
+
+ public:
+  // Makes new links with a single reference that belongs to the caller. The
+  // links start out empty or share the blocks of other links. Links for the
+  // tuple that get_block(...) returns are made empty first and then appended
+  // to, so that failing to make them doesn't leave the tuple's references
+  // behind.
+  template <class... Args>
+  static block_links *make(AllocatorT *allocator, Args &&... args) {
+    typename links_allocator::type a = links_allocator::make(allocator);
+    block_links *fresh = a.allocate(1);
+    try {
+      ::new (static_cast<void *>(fresh))
+          block_links(allocator, std::forward<Args>(args)...);
+    } catch (...) {
+      a.deallocate(fresh, 1);
+      throw;
+    }
+    return fresh;
+  }
+
+  static void acquire(block_links *l) {
+#ifdef CHAIN_COUNT_REFERENCES
+    if (l != nullptr) ++link_reference_traffic();
+#endif
+    if (l != nullptr) count_reference(l->refcount);
+  }
+
+  static void release(block_links *l) {
+#ifdef CHAIN_COUNT_REFERENCES
+    if (l != nullptr) ++link_reference_traffic();
+#endif
+    if (l != nullptr && drop_reference(l->refcount)) {
+      typename links_allocator::type a = links_allocator::make(l->allocator);
+      l->~block_links();
+      a.deallocate(l, 1);
     }
-    assert(current_block != nullptr && !total_length && "We've been given a bogus tuple.");
+  }
+
+  // Makes room for at least n links.
+  void reserve(size_t n) {
+    if (n <= reserved) return;
+    assert(n <= UINT32_MAX && "Too many links.");
+    size_t grown = std::min<size_t>(UINT32_MAX, std::max<size_t>(n, 2 * reserved));
+    typename link_allocator::type a = link_allocator::make(allocator);
+    link_type *moved = a.allocate(grown);
+    std::copy(links, links + count, moved);
+    free_links();
+    links = moved;
+    reserved = static_cast<uint32_t>(grown);
+  }
+
+  // Lets go of all the links.
+  void clear() noexcept {
+    for (link_type const &l : *this) block_type::release(l.target);
+    count = 0;
+    total = 0;
+  }
+
+  // Whether the caller holds the only reference to the links, in which case
+  // it can clear them and fill them again instead of making new ones.
+  bool unique() const { return refcount.load(std::memory_order_acquire) == 1; }
+
+  const_iterator begin() const { return links; }
+  const_iterator end() const { return links + count; }
+  bool empty() const { return count == 0; }
+  size_t link_count() const { return count; }
+  size_t size() const { return total; }
+
+  // Adds all the links from other to the end of these links, sharing the
+  // blocks they refer to.
+  void extend(block_links const &other) {
+    reserve(count + other.count);
+    for (link_type const &l : other) {
+      block_type::acquire(l.target);
+      push_link(l.target, l.offset, l.length);
+    }
+  }
+
+  // Adds links to the length elements of other starting at offset to the end
+  // of these links, sharing the blocks they refer to. Only the links at
+  // either end of the range get cut short.
+  void extend(block_links const &other, size_t offset, size_t length) {
+    const_iterator l = other.begin();
+    while (l != other.end() && offset >= l->length) {
+      offset -= l->length;
+      ++l;
+    }
+    if (!length) return;
+    // The first link may continue our last one, so it goes through push_link.
+    assert(l != other.end() && "Invalid offset and length parameters.");
+    size_t part = std::min<size_t>(length, l->length - offset);
+    block_type::acquire(l->target);
+    push_link(l->target, l->offset + offset, part);
+    length -= part;
+    ++l;
+    // The links in the middle are taken whole, and already can't be joined
+    // with each other, so we copy them in one go.
+    const_iterator middle = l;
+    size_t whole = 0;
+    while (l != other.end() && l->length <= length - whole) whole += (l++)->length;
+    if (middle != l) {
+      reserve(count + (l - middle) + 1);
+      std::copy(middle, l, links + count);
+      for (const_iterator m = middle; m != l; ++m) block_type::acquire(m->target);
+      count += static_cast<uint32_t>(l - middle);
+      total += whole;
+      length -= whole;
+    }
+    if (length) {
+      assert(l != other.end() && "Invalid offset and length parameters.");
+      block_type::acquire(l->target);
+      push_link(l->target, l->offset, length);
+    }
+  }
+
+  // Moves all the links from other to the end of these links, references and
+  // all, leaving other empty.
+  void splice(block_links &other) {
+    extend(other);
+    other.clear();
+  }
+
+  // Adds a single link at the end, taking over one reference to the block. If
+  // the link continues right where the last link ends in the same block we just
+  // extend the last link instead.
+  void push_link(block_type *b, size_t offset, size_t length) {
+    assert(offset + length <= b->capacity && "The link doesn't fit the block.");
+    if (count) {
+      link_type &last = links[count - 1];
+      if (last.target == b && size_t(last.offset) + last.length == offset) {
+        // Since the last link and the one being appended point to the same
+        // block, we just modify the length parameter. This is so that we
+        // conserve the space needed to both refer to the same block. The last
+        // link already holds a reference so we let go of the one given.
+        last.length += static_cast<uint32_t>(length);
+        total += length;
+        block_type::release(b);
+        return;
+      }
+    }
+    try {
+      reserve(count + 1);
+    } catch (...) {
+      block_type::release(b);
+      throw;
+    }
+    links[count++] = link_type{b, static_cast<uint32_t>(offset),
+                               static_cast<uint32_t>(length)};
+    total += length;
   }
 
   // The fundamental operation for block_links is appending of blocks. The links can only
   // grow but we can't really shrink them, except in a subscript operation that creates
-  // a new chain.
+  // a new chain. The tuple is what get_block(...) returns: we walk the blocks it spans
+  // and determine the correct lengths for each block-offset-length from there.
   void append(block_offset_length_tuple &&t) {
-    block<CharT, AllocatorT> *&current_block = get<0>(t);
-    if (get<0>(links.back()) == current_block) {
-      // Since the last link and the one being appended point to the same block, we just
-      // modify the length parameter. This is so that we conserve the space needed to
-      // both refer to the same block.
-      get<2>(links.back()) += get<2>(t);
-      // We also increase the refcount to the block.
-      ++current_block->refcount;
+    block_type *current_block = std::get<0>(t);
+    size_t block_offset = std::get<1>(t);
+    size_t remaining = std::get<2>(t);
+    while (remaining) {
+      assert(current_block != nullptr && "We've been given a bogus tuple.");
+      size_t length = std::min(remaining, current_block->filled - block_offset);
+      remaining -= length;
+      // We only look past the blocks we hold references to, which are the
+      // only ones that can't be taken out of the list while we're at it.
+      block_type *following = remaining ? current_block->next : nullptr;
+      try {
+        push_link(current_block, block_offset, length);
+      } catch (...) {
+        // The blocks we haven't gotten to yet still hold a reference for us.
+        for (block_type *b = following; remaining;) {
+          block_type *next = b->next;
+          remaining -= std::min(remaining, b->filled);
+          block_type::release(b);
+          b = next;
+        }
+        throw;
+      }
+      block_offset = 0;  // We then always refer to the beginning of the next block.
+      current_block = following;
     }
   }
 
   // The slicing operation on the other hand does block offset length calculus instead.
   // This operation only modifies the links this current links container contains. The
   // operands denote the new beginning of the links to use, and the new length.
-  void slice(size_t offset, size_t length) {
-    for (block_offset_length_tuple &t : links) {
-      block<CharT, AllocatorT> *&current_block = get<0>(t);
-      size_t &block_offset = get<1>(t);
-      size_t &block_length = get<2>(t);
-      tie(current_block, block_offset, block_length) = t;
-      assert(current_block != nullptr && "Gone off the rails.");
-      if (offset > block_length) {
-        if (!--current_block->refcount) {
-          // Refcount is 0 for the block so we delete it.
-          delete current_block;
-        }
-        links.pop_front();
-        offset -= block_length;
-      } else {
-        if (offset) {
-          block_offset += offset;
-          block_length -= offset;
-          offset = 0;
-        } else {
-          if (length < block_length) {
-            block_length -= length;
-            if (block_length == 0) {
-              if (!--current_block->refcount) {
-                delete current_block;
-              }
-              links.pop_back();
-            }
-            break;
-          } else {
-            length -= block_length;
-          }
+  void slice(size_t offset, size_t length) noexcept {
+    total = length;
+    // First we find the first link that ends after the new beginning.
+    size_t first = 0;
+    while (first < count && offset >= links[first].length) {
+      offset -= links[first].length;
+      ++first;
+    }
+    assert((first == count ? !offset && !length : true) &&
+           "Invalid offset and length parameters.");
+    // Then we find the link where the new end falls in.
+    size_t last = first;
+    if (first < count) {
+      links[first].offset += static_cast<uint32_t>(offset);
+      links[first].length -= static_cast<uint32_t>(offset);
+      while (last < count && length) {
+        uint32_t &link_length = links[last].length;
+        link_length = static_cast<uint32_t>(std::min<size_t>(link_length, length));
+        length -= link_length;
+        ++last;
+      }
+    }
+    assert(!length && "Invalid offset and length parameters.");
+    // Everything outside [first, last) goes, and the rest moves to the front.
+    for (size_t i = 0; i < first; ++i) block_type::release(links[i].target);
+    for (size_t i = last; i < count; ++i) block_type::release(links[i].target);
+    std::copy(links + first, links + last, links);
+    count = static_cast<uint32_t>(last - first);
+  }
+
+  // Lexicographic three-way comparison of the contents referred to by two
+  // sets of links, returning a negative number, zero or a positive number. We
+  // walk both sets of links in lockstep, comparing the overlapping parts of the
+  // current links on either side. When both sides are looking at the very same
+  // elements of the same block there's nothing to compare.
+  //
+  // Chains derived from the same source (through copies, slices and
+  // concatenation) tend to have whole links in common. Whenever both sides are
+  // at the start of a link and the links are identical we skip them without
+  // even looking at the blocks they refer to.
+  int compare(block_links const &other) const {
+    const_iterator i = begin(), j = other.begin();
+    CharT const *left = nullptr, *right = nullptr;
+    size_t left_length = 0, right_length = 0;
+    for (;;) {
+      if (!left_length && !right_length) {
+        while (i != end() && j != other.end() && *i == *j) {
+          ++i;
+          ++j;
         }
       }
+      if (!left_length) {
+        if (i == end()) break;
+        left = i->data();
+        left_length = i->length;
+        ++i;
+      }
+      if (!right_length) {
+        if (j == other.end()) break;
+        right = j->data();
+        right_length = j->length;
+        ++j;
+      }
+      size_t common = std::min(left_length, right_length);
+      if (left != right) {
+        int result = compare_elements(left, right, common);
+        if (result) return result;
+      }
+      left += common;
+      right += common;
+      left_length -= common;
+      right_length -= common;
     }
-    assert(!offset && !length && "Invalid offset and length parameters.")
+    // Whichever side still has elements left is the greater one.
+    bool left_done = !left_length && i == end();
+    bool right_done = !right_length && j == other.end();
+    return left_done == right_done ? 0 : left_done ? -1 : 1;
+  }
+
+  // Element-wise equality of the contents referred to by two sets of links.
+  // Links of different lengths can't be equal, which we know without looking
+  // at any of the blocks.
+  bool equal(block_links const &other) const {
+    return total == other.total && compare(other) == 0;
   }
 
   ~block_links() {
-    for (auto i = links.begin(); i != links.end(); ++i) {
-      block<CharT, AllocatorT> *&current_block = get<0>(*i);
-      if (!--current_block->refcount) delete current_block;
+    clear();
+    free_links();
+  }
+};
+
+
+// The block writer lets us produce the contents of a new chain element by
+// element, straight into the pages of the blocks, without having to build the
+// whole contents up front somewhere else. By default it fills the last block
+// shared by everything else, so only one such writer should be filling pages
+// for a given element and allocator type at any given time. Writers with
+// exclusive pages get blocks of their own instead, which lets many of them
+// work at the same time on different threads.
+template <class CharT, class AllocatorT>
+class block_writer {
+  typedef block<CharT, AllocatorT> block_type;
+  typedef block_links<CharT, AllocatorT> links_type;
+
+ public:
+  enum page_mode { shared_pages, exclusive_pages };
+
+ private:
+  AllocatorT *allocator;
+  page_mode mode;
+  links_type *links;
+  block_type *current;
+  // Whether the current block is referred to by the writer alone while it's
+  // still filling it, as exclusive pages and reserved blocks are.
+  bool owns_current;
+  // How many more elements we've been told are coming, which go into blocks
+  // of their own.
+  size_t reserved;
+  CharT *cursor, *limit;
+
+  void open_reserved() {
+    size_t n = std::min(reserved, block_type::largest_block());
+    current = block_type::new_block(allocator, nullptr, n);
+    owns_current = true;
+    cursor = current->page();
+    limit = current->page() + n;
+  }
+
+  void close_page() {
+    if (owns_current && current != nullptr) {
+      block_type::release(current);
+    }
+    current = nullptr;
+    owns_current = false;
+  }
+
+  block_writer(block_writer const &) = delete;
+  block_writer &operator=(block_writer const &) = delete;
+
+  // Turns what we've written into the current page so far into a link.
+  void flush() {
+    if (current == nullptr) return;
+    size_t written = cursor - (current->page() + current->filled);
+    if (!written) return;
+    size_t offset = current->filled;
+    current->filled += written;
+    current->flags = 0;
+    block_type::acquire(current);
+    links->push_link(current, offset, written);
+  }
+
+ public:
+  // Writers for allocators that aren't stateless, arenas included, always get
+  // pages of their own.
+  explicit block_writer(AllocatorT *allocator, page_mode mode = shared_pages)
+  : allocator(allocator)
+  , mode(stateless_allocator<AllocatorT>::value ? mode : exclusive_pages)
+  , links(links_type::make(allocator)), current(nullptr), owns_current(false), reserved(0), cursor(nullptr), limit(nullptr)
+  {}
+
+  // When we know how many more elements are going to be written we can have
+  // them go into blocks of exactly the right size, allocated in one go up to
+  // a generous limit, instead of a page at a time. These blocks aren't shared
+  // with anything else.
+  void reserve(size_t n) {
+    reserved = n;
+    if (n <= static_cast<size_t>(limit - cursor)) return;
+    flush();
+    close_page();
+    open_reserved();
+  }
+
+  // Gives access to the room left in the current page, moving on to a new page
+  // if the current one is already full. Whatever gets written there only
+  // becomes part of the contents once we advance past it.
+  CharT *window(size_t &available) {
+    if (cursor == limit) {
+      flush();
+      close_page();
+      if (reserved) {
+        open_reserved();
+        available = limit - cursor;
+        return cursor;
+      }
+      current = mode == shared_pages ? block_type::open_block(allocator)
+                                     : block_type::new_block(allocator, nullptr);
+      owns_current = mode == exclusive_pages;
+      cursor = current->page() + current->filled;
+      limit = current->page() + current->capacity;
+    }
+    available = limit - cursor;
+    return cursor;
+  }
+
+  void advance(size_t n) {
+    assert(cursor + n <= limit && "Advancing past the end of the page.");
+    cursor += n;
+    reserved -= std::min(reserved, n);
+  }
+
+  void put(CharT c) {
+    if (cursor == limit) {
+      size_t available;
+      window(available);
     }
+    *cursor++ = c;
+    if (reserved) --reserved;
   }
 
+  void write(CharT const *contents, size_t length) {
+    while (length) {
+      size_t available;
+      CharT *destination = window(available);
+      size_t segment = std::min(available, length);
+      std::copy(contents, contents + segment, destination);
+      advance(segment);
+      contents += segment;
+      length -= segment;
+    }
+  }
+
+  // Hands over the links to everything written so far. The writer is done
+  // after this and shouldn't be used anymore.
+  links_type *finish() {
+    flush();
+    close_page();
+    cursor = limit = nullptr;
+    links_type *result = links;
+    links = nullptr;
+    return result;
+  }
+
+  ~block_writer() {
+    close_page();
+    links_type::release(links);
+  }
 };
 
 }  // namespace detail
@@ -0,0 +1,121 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DETAIL_BULK_COPY_HPP
+#define DETAIL_BULK_COPY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <chain/detail/block_links.hpp>
+
+namespace chain {
+
+namespace detail {
+
+// Copies that are larger than this many bytes would just push everything else
+// out of the caches, and what they write isn't going to be read again any time
+// soon, so they bypass the caches altogether. Below about the size of a last
+// level cache the ordinary stores are still faster.
+size_t const streaming_copy_threshold = size_t(16) << 20;
+
+// How far ahead in the next link we ask the processor to start fetching while
+// we're still copying the current one. The hardware prefetchers take care of
+// reading ahead within a page but can't guess which page comes next.
+size_t const prefetch_distance = 256;
+
+// Copies length bytes, with non-temporal stores if streaming is set. The
+// streaming stores start at a cache line boundary so that every line is
+// written whole; partially written lines are much slower to flush. The caller
+// has to issue a store fence once it's done with all its streaming copies.
+inline void copy_bytes(void *destination, void const *source, size_t length,
+                       bool streaming) {
+#ifdef __SSE2__
+  if (streaming && length >= 64) {
+    char *d = static_cast<char *>(destination);
+    char const *s = static_cast<char const *>(source);
+    size_t head = (64 - (reinterpret_cast<uintptr_t>(d) & 63)) & 63;
+    std::memcpy(d, s, head);
+    d += head;
+    s += head;
+    length -= head;
+    for (; length >= 64; d += 64, s += 64, length -= 64) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s + 16));
+      __m128i c = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s + 32));
+      __m128i e = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s + 48));
+      _mm_stream_si128(reinterpret_cast<__m128i *>(d), a);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(d + 16), b);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(d + 32), c);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(d + 48), e);
+    }
+    std::memcpy(d, s, length);
+    return;
+  }
+#endif
+  std::memcpy(destination, source, length);
+}
+
+inline void finish_streaming() {
+#ifdef __SSE2__
+  _mm_sfence();
+#endif
+}
+
+// Copies the elements all the links refer to into the writer's pages. The
+// writer fills every page before moving on to the next one, so the copy ends
+// up in as few pages, and as few links, as possible no matter how fragmented
+// the source is. Returns the number of elements copied.
+template <class CharT, class AllocatorT>
+size_t bulk_copy(block_writer<CharT, AllocatorT> &writer,
+                 block_links<CharT, AllocatorT> const &links, bool streaming) {
+  typedef typename block_links<CharT, AllocatorT>::const_iterator iterator;
+  size_t copied = 0;
+  for (iterator i = links.begin(); i != links.end(); ++i) {
+    iterator following = i;
+    if (++following != links.end()) {
+      char const *ahead = reinterpret_cast<char const *>(following->data());
+      for (size_t line = 0; line < prefetch_distance; line += 64) {
+        __builtin_prefetch(ahead + line);
+      }
+    }
+    CharT const *source = i->data();
+    size_t remaining = i->length;
+    while (remaining) {
+      size_t available;
+      CharT *destination = writer.window(available);
+      size_t segment = std::min(available, remaining);
+      copy_bytes(destination, source, segment * sizeof(CharT), streaming);
+      writer.advance(segment);
+      source += segment;
+      remaining -= segment;
+      copied += segment;
+    }
+  }
+  if (streaming) finish_streaming();
+  return copied;
+}
+
+// Copies the links into a single block of just the right size, with
+// non-temporal stores if there's enough to copy for it to be worth it.
+template <class CharT, class AllocatorT>
+size_t bulk_copy(block_writer<CharT, AllocatorT> &writer,
+                 block_links<CharT, AllocatorT> const &links) {
+  writer.reserve(links.size());
+  return bulk_copy(writer, links,
+                   links.size() * sizeof(CharT) >= streaming_copy_threshold);
+}
+
+}  // namespace detail
+
+}  // namespace chain
+
+#endif  // DETAIL_BULK_COPY_HPP
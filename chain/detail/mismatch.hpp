@@ -0,0 +1,133 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DETAIL_MISMATCH_HPP
+#define DETAIL_MISMATCH_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace chain {
+
+namespace detail {
+
+// Returns the index of the first element where left and right differ, or
+// length if they're the same throughout. Equality of elements is equality of
+// their bytes, so we compare 16 bytes at a time and work out which element the
+// first differing byte belongs to.
+template <class Element>
+size_t mismatch(Element const *left, Element const *right, size_t length) {
+  size_t i = 0;
+#ifdef __SSE2__
+  size_t const per_vector = 16 / sizeof(Element);
+  for (; i + per_vector <= length; i += per_vector) {
+    __m128i l = _mm_loadu_si128(reinterpret_cast<__m128i const *>(left + i));
+    __m128i r = _mm_loadu_si128(reinterpret_cast<__m128i const *>(right + i));
+    unsigned equal = _mm_movemask_epi8(_mm_cmpeq_epi8(l, r));
+    if (equal != 0xffff) {
+      return i + __builtin_ctz(~equal) / sizeof(Element);
+    }
+  }
+#endif
+  for (; i < length && left[i] == right[i]; ++i) {}
+  return i;
+}
+
+// Three-way comparison of two runs of the same length. Elements compare as
+// unsigned values the same way std::char_traits does for strings.
+template <class Element>
+int compare_elements(Element const *left, Element const *right, size_t length) {
+  typedef typename std::make_unsigned<Element>::type unsigned_element;
+  size_t i = mismatch(left, right, length);
+  if (i == length) return 0;
+  return static_cast<unsigned_element>(left[i]) <
+         static_cast<unsigned_element>(right[i]) ? -1 : 1;
+}
+
+// The C library's memcmp is already as fast as it gets for bytes.
+inline int compare_elements(char const *left, char const *right, size_t length) {
+  int result = std::memcmp(left, right, length);
+  return (result > 0) - (result < 0);
+}
+
+inline int compare_elements(unsigned char const *left, unsigned char const *right,
+                            size_t length) {
+  int result = std::memcmp(left, right, length);
+  return (result > 0) - (result < 0);
+}
+
+// Returns the index of the first element equal to e, or length if there's
+// none. Wider elements are compared 16 bytes at a time, while the C library
+// already has the fastest way to find a byte.
+template <class Element>
+size_t find_element(Element const *elements, size_t length, Element e) {
+  size_t i = 0;
+#ifdef __SSE2__
+  if (sizeof(Element) == 2 || sizeof(Element) == 4) {
+    size_t const per_vector = 16 / sizeof(Element);
+    __m128i wanted = sizeof(Element) == 2 ? _mm_set1_epi16(static_cast<short>(e))
+                                          : _mm_set1_epi32(static_cast<int>(e));
+    for (; i + per_vector <= length; i += per_vector) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(elements + i));
+      unsigned equal = _mm_movemask_epi8(sizeof(Element) == 2
+                                             ? _mm_cmpeq_epi16(v, wanted)
+                                             : _mm_cmpeq_epi32(v, wanted));
+      if (equal) return i + __builtin_ctz(equal) / sizeof(Element);
+    }
+  }
+#endif
+  for (; i < length && elements[i] != e; ++i) {}
+  return i;
+}
+
+inline size_t find_element(char const *elements, size_t length, char e) {
+  void const *found = std::memchr(elements, e, length);
+  return found == nullptr ? length : static_cast<char const *>(found) - elements;
+}
+
+inline size_t find_element(unsigned char const *elements, size_t length,
+                           unsigned char e) {
+  void const *found = std::memchr(elements, e, length);
+  return found == nullptr ? length
+                          : static_cast<unsigned char const *>(found) - elements;
+}
+
+// Adds the index of every element equal to e, plus base, to found. Bytes are
+// compared 16 at a time and every match in those 16 comes out of the same
+// mask, which is faster than finding them one at a time when they're close
+// together, as newlines are.
+template <class Element, class Index>
+void find_all_elements(Element const *elements, size_t length, Element e,
+                       std::vector<Index> &found, size_t base) {
+  size_t i = 0;
+#ifdef __SSE2__
+  if (sizeof(Element) == 1) {
+    __m128i wanted = _mm_set1_epi8(static_cast<char>(e));
+    for (; i + 16 <= length; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(elements + i));
+      unsigned equal = _mm_movemask_epi8(_mm_cmpeq_epi8(v, wanted));
+      for (; equal; equal &= equal - 1) {
+        found.push_back(static_cast<Index>(base + i + __builtin_ctz(equal)));
+      }
+    }
+  }
+#endif
+  for (i += find_element(elements + i, length - i, e); i < length;
+       i += 1 + find_element(elements + i + 1, length - i - 1, e)) {
+    found.push_back(static_cast<Index>(base + i));
+  }
+}
+
+}  // namespace detail
+
+}  // namespace chain
+
+#endif  // DETAIL_MISMATCH_HPP
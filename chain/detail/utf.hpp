@@ -0,0 +1,422 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DETAIL_UTF_HPP
+#define DETAIL_UTF_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <chain/detail/block_links.hpp>
+
+namespace chain {
+
+namespace detail {
+
+// The encoding of a chain is implied by the width of its elements: 8-bit
+// elements hold UTF-8, 16-bit elements hold UTF-16 and 32-bit elements hold
+// UTF-32.
+template <class Unit>
+inline char32_t unit_value(Unit u) {
+  return static_cast<typename std::make_unsigned<Unit>::type>(u);
+}
+
+// The vectorized kernels copy whole 16-byte runs of ASCII units, widening or
+// narrowing them on the way. They stop at the first run that has anything
+// outside of ASCII in it and leave the rest to the scalar loop.
+template <size_t InSize, size_t OutSize>
+struct ascii_vector {
+  template <class In, class Out>
+  static size_t run(In const *, Out *, size_t) { return 0; }
+};
+
+#ifdef __SSE2__
+template <>
+struct ascii_vector<1, 1> {
+  template <class In, class Out>
+  static size_t run(In const *in, Out *out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i));
+      if (_mm_movemask_epi8(v)) break;
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), v);
+    }
+    return i;
+  }
+};
+
+template <>
+struct ascii_vector<1, 2> {
+  template <class In, class Out>
+  static size_t run(In const *in, Out *out, size_t n) {
+    __m128i const zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i));
+      if (_mm_movemask_epi8(v)) break;
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                       _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8),
+                       _mm_unpackhi_epi8(v, zero));
+    }
+    return i;
+  }
+};
+
+template <>
+struct ascii_vector<1, 4> {
+  template <class In, class Out>
+  static size_t run(In const *in, Out *out, size_t n) {
+    __m128i const zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i));
+      if (_mm_movemask_epi8(v)) break;
+      __m128i low = _mm_unpacklo_epi8(v, zero), high = _mm_unpackhi_epi8(v, zero);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                       _mm_unpacklo_epi16(low, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4),
+                       _mm_unpackhi_epi16(low, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8),
+                       _mm_unpacklo_epi16(high, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 12),
+                       _mm_unpackhi_epi16(high, zero));
+    }
+    return i;
+  }
+};
+
+template <>
+struct ascii_vector<2, 1> {
+  template <class In, class Out>
+  static size_t run(In const *in, Out *out, size_t n) {
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const non_ascii = _mm_set1_epi16(static_cast<short>(0xff80));
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m128i low = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i));
+      __m128i high = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i + 8));
+      __m128i outside = _mm_and_si128(_mm_or_si128(low, high), non_ascii);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(outside, zero)) != 0xffff) break;
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                       _mm_packus_epi16(low, high));
+    }
+    return i;
+  }
+};
+#endif  // __SSE2__
+
+// Copies the leading run of ASCII units from [first, last) into out, which has
+// room for at most room units. Returns how many units were copied.
+template <class In, class Out>
+size_t copy_ascii(In const *first, In const *last, Out *out, size_t room) {
+  size_t n = std::min<size_t>(last - first, room);
+  size_t i = ascii_vector<sizeof(In), sizeof(Out)>::run(first, out, n);
+  for (; i < n && unit_value(first[i]) < 0x80; ++i) {
+    out[i] = static_cast<Out>(first[i]);
+  }
+  return i;
+}
+
+
+// The encoders write code points straight into the pages of a new chain
+// through a block writer.
+template <class Out, class Allocator, size_t Size = sizeof(Out)>
+class utf_encoder;
+
+template <class Out, class Allocator>
+class utf_encoder_base {
+ protected:
+  block_writer<Out, Allocator> &writer;
+
+ public:
+  explicit utf_encoder_base(block_writer<Out, Allocator> &writer)
+  : writer(writer) {}
+
+  // Copies as much of the leading ASCII run from the input as there is,
+  // returning how many input units were consumed.
+  template <class In>
+  size_t ascii(In const *first, In const *last) {
+    size_t consumed = 0;
+    while (first != last) {
+      size_t available;
+      Out *destination = writer.window(available);
+      size_t copied = copy_ascii(first, last, destination, available);
+      writer.advance(copied);
+      consumed += copied;
+      first += copied;
+      if (copied < available) break;
+    }
+    return consumed;
+  }
+
+  // Copies input that we already know is all ASCII without checking it again.
+  template <class In>
+  void widen(In const *first, In const *last) {
+    while (first != last) {
+      size_t available;
+      Out *destination = writer.window(available);
+      size_t segment = std::min<size_t>(available, last - first);
+      for (size_t i = 0; i < segment; ++i) {
+        destination[i] = static_cast<Out>(first[i]);
+      }
+      writer.advance(segment);
+      first += segment;
+    }
+  }
+};
+
+template <class Out, class Allocator>
+class utf_encoder<Out, Allocator, 1> : public utf_encoder_base<Out, Allocator> {
+ public:
+  explicit utf_encoder(block_writer<Out, Allocator> &writer)
+  : utf_encoder_base<Out, Allocator>(writer) {}
+
+  void code_point(char32_t c) {
+    block_writer<Out, Allocator> &w = this->writer;
+    if (c < 0x80) {
+      w.put(static_cast<Out>(c));
+    } else if (c < 0x800) {
+      w.put(static_cast<Out>(0xC0 | (c >> 6)));
+      w.put(static_cast<Out>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+      w.put(static_cast<Out>(0xE0 | (c >> 12)));
+      w.put(static_cast<Out>(0x80 | ((c >> 6) & 0x3F)));
+      w.put(static_cast<Out>(0x80 | (c & 0x3F)));
+    } else {
+      w.put(static_cast<Out>(0xF0 | (c >> 18)));
+      w.put(static_cast<Out>(0x80 | ((c >> 12) & 0x3F)));
+      w.put(static_cast<Out>(0x80 | ((c >> 6) & 0x3F)));
+      w.put(static_cast<Out>(0x80 | (c & 0x3F)));
+    }
+  }
+};
+
+template <class Out, class Allocator>
+class utf_encoder<Out, Allocator, 2> : public utf_encoder_base<Out, Allocator> {
+ public:
+  explicit utf_encoder(block_writer<Out, Allocator> &writer)
+  : utf_encoder_base<Out, Allocator>(writer) {}
+
+  void code_point(char32_t c) {
+    if (c < 0x10000) {
+      this->writer.put(static_cast<Out>(c));
+    } else {
+      c -= 0x10000;
+      this->writer.put(static_cast<Out>(0xD800 + (c >> 10)));
+      this->writer.put(static_cast<Out>(0xDC00 + (c & 0x3FF)));
+    }
+  }
+};
+
+template <class Out, class Allocator>
+class utf_encoder<Out, Allocator, 4> : public utf_encoder_base<Out, Allocator> {
+ public:
+  explicit utf_encoder(block_writer<Out, Allocator> &writer)
+  : utf_encoder_base<Out, Allocator>(writer) {}
+
+  void code_point(char32_t c) {
+    this->writer.put(static_cast<Out>(c));
+  }
+};
+
+
+// The decoders validate their input as they go and keep enough state to pick
+// up a sequence that was split between two links. They return false as soon as
+// they see anything malformed.
+template <size_t Size>
+class utf_decoder;
+
+template <>
+class utf_decoder<1> {
+  char32_t code_point;
+  unsigned pending;
+  // The range of the next continuation byte, which is narrower than usual right
+  // after some lead bytes to rule out overlong forms, surrogates and code points
+  // beyond U+10FFFF.
+  unsigned char lower, upper;
+
+  static bool continuation(char32_t c) { return (c & 0xC0) == 0x80; }
+
+ public:
+  utf_decoder() : code_point(0), pending(0), lower(0x80), upper(0xBF) {}
+
+  template <class Unit, class Encoder>
+  bool decode(Unit const *p, Unit const *end, Encoder &out) {
+    while (p != end) {
+      if (pending) {
+        char32_t c = unit_value(*p++);
+        if (c < lower || c > upper) return false;
+        code_point = (code_point << 6) | (c & 0x3F);
+        lower = 0x80;
+        upper = 0xBF;
+        if (!--pending) out.code_point(code_point);
+        continue;
+      }
+      p += out.ascii(p, end);
+      if (p == end) break;
+      char32_t lead = unit_value(*p);
+      size_t left = end - p;
+      // The two and three byte sequences are the common ones outside of ASCII,
+      // so we decode those directly when they're whole in this link.
+      if (lead >= 0xC2 && lead <= 0xDF) {
+        if (left >= 2 && continuation(unit_value(p[1]))) {
+          out.code_point(((lead & 0x1F) << 6) | (unit_value(p[1]) & 0x3F));
+          p += 2;
+          continue;
+        }
+        code_point = lead & 0x1F;
+        pending = 1;
+      } else if (lead >= 0xE0 && lead <= 0xEF) {
+        lower = lead == 0xE0 ? 0xA0 : 0x80;
+        upper = lead == 0xED ? 0x9F : 0xBF;
+        if (left >= 3) {
+          char32_t second = unit_value(p[1]), third = unit_value(p[2]);
+          if (second >= lower && second <= upper && continuation(third)) {
+            out.code_point(((lead & 0x0F) << 12) | ((second & 0x3F) << 6) |
+                           (third & 0x3F));
+            lower = 0x80;
+            upper = 0xBF;
+            p += 3;
+            continue;
+          }
+        }
+        code_point = lead & 0x0F;
+        pending = 2;
+      } else if (lead >= 0xF0 && lead <= 0xF4) {
+        lower = lead == 0xF0 ? 0x90 : 0x80;
+        upper = lead == 0xF4 ? 0x8F : 0xBF;
+        code_point = lead & 0x07;
+        pending = 3;
+      } else {
+        return false;
+      }
+      ++p;
+    }
+    return true;
+  }
+
+  // The input is only well-formed if it didn't end in the middle of a
+  // sequence.
+  bool finish() const { return !pending; }
+};
+
+template <>
+class utf_decoder<2> {
+  char32_t high;
+  bool pending;
+
+ public:
+  utf_decoder() : high(0), pending(false) {}
+
+  template <class Unit, class Encoder>
+  bool decode(Unit const *p, Unit const *end, Encoder &out) {
+    while (p != end) {
+      if (!pending) {
+        p += out.ascii(p, end);
+        if (p == end) break;
+      }
+      char32_t c = unit_value(*p++);
+      if (pending) {
+        if (c < 0xDC00 || c > 0xDFFF) return false;
+        out.code_point(0x10000 + ((high - 0xD800) << 10) + (c - 0xDC00));
+        pending = false;
+      } else if (c < 0xD800 || c > 0xDFFF) {
+        out.code_point(c);
+      } else if (c <= 0xDBFF) {
+        high = c;
+        pending = true;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool finish() const { return !pending; }
+};
+
+template <>
+class utf_decoder<4> {
+ public:
+  template <class Unit, class Encoder>
+  bool decode(Unit const *p, Unit const *end, Encoder &out) {
+    while (p != end) {
+      p += out.ascii(p, end);
+      if (p == end) break;
+      char32_t c = unit_value(*p++);
+      if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) return false;
+      out.code_point(c);
+    }
+    return true;
+  }
+
+  bool finish() const { return true; }
+};
+
+
+// Validating construction copies UTF-8 into the pages and checks it in the same
+// pass, so every byte is only touched once. It has the same shape as the plain
+// copy used by get_block(...) and tells us whether each segment was all ASCII.
+// Sequences are allowed to continue from one segment into the next, so a page
+// marked as valid UTF-8 might still start or end in the middle of a sequence.
+template <class Unit>
+class utf8_validating_copy {
+  unsigned pending;
+  unsigned char lower, upper;
+
+ public:
+  utf8_validating_copy() : pending(0), lower(0x80), upper(0xBF) {}
+
+  bool operator()(Unit const *contents, size_t length, Unit *destination,
+                  unsigned char &segment_flags) {
+    bool ascii = true;
+    size_t i = 0;
+    while (i < length) {
+      if (!pending) {
+        i += copy_ascii(contents + i, contents + length, destination + i,
+                        length - i);
+        if (i == length) break;
+      }
+      ascii = false;
+      char32_t c = unit_value(contents[i]);
+      destination[i] = contents[i];
+      ++i;
+      if (pending) {
+        if (c < lower || c > upper) return false;
+        lower = 0x80;
+        upper = 0xBF;
+        --pending;
+      } else if (c >= 0xC2 && c <= 0xDF) {
+        pending = 1;
+      } else if (c >= 0xE0 && c <= 0xEF) {
+        lower = c == 0xE0 ? 0xA0 : 0x80;
+        upper = c == 0xED ? 0x9F : 0xBF;
+        pending = 2;
+      } else if (c >= 0xF0 && c <= 0xF4) {
+        lower = c == 0xF0 ? 0x90 : 0x80;
+        upper = c == 0xF4 ? 0x8F : 0xBF;
+        pending = 3;
+      } else {
+        return false;
+      }
+    }
+    segment_flags = valid_utf8 | (ascii ? ascii_only : 0);
+    return true;
+  }
+
+  bool finish() const { return !pending; }
+};
+
+}  // namespace detail
+
+}  // namespace chain
+
+#endif  // DETAIL_UTF_HPP
@@ -0,0 +1,211 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// hash_index.hpp
+//
+#ifndef CHAIN_HASH_INDEX_HPP
+#define CHAIN_HASH_INDEX_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include <chain/chain.hpp>
+#include <chain/parallel.hpp>
+
+namespace chain {
+
+  namespace detail {
+    // Hashes are polynomials in a random base modulo the Mersenne prime
+    // 2^61 - 1, which makes the reduction after a multiplication cheap.
+    __extension__ typedef unsigned __int128 uint128_t;
+
+    uint64_t const hash_modulus = (uint64_t(1) << 61) - 1;
+
+    inline uint64_t hash_multiply(uint64_t a, uint64_t b) {
+      uint128_t product = static_cast<uint128_t>(a) * b;
+      uint64_t result = static_cast<uint64_t>(product & hash_modulus) +
+                        static_cast<uint64_t>(product >> 61);
+      return result >= hash_modulus ? result - hash_modulus : result;
+    }
+
+    inline uint64_t hash_add(uint64_t a, uint64_t b) {
+      uint64_t result = a + b;
+      return result >= hash_modulus ? result - hash_modulus : result;
+    }
+
+    inline uint64_t hash_subtract(uint64_t a, uint64_t b) {
+      return a >= b ? a - b : a + hash_modulus - b;
+    }
+  }  // namespace detail
+
+  // Chains never change once they're constructed, so the hashes of all their
+  // prefixes can be worked out once and kept around. A hash index does that
+  // for a chain and uses those hashes to tell whether two slices of the chain
+  // are equal in constant time, and how far two positions in the chain agree
+  // in logarithmic time.
+  //
+  // The index keeps the chain alive and is only built the first time it's
+  // asked anything, one group of links per task on the given thread pool. It
+  // can then be queried from several threads at once. Equality is decided by
+  // comparing 61-bit hashes in a base that's picked at random for every index,
+  // so two different slices of length n compare equal with a probability of
+  // at most n / 2^61.
+  template <class Element, class Allocator>
+  class hash_index {
+   public:
+    explicit hash_index(chain_t<Element, Allocator> const &c,
+                        thread_pool &pool = detail::default_pool())
+    : chain_(c), pool_(pool), base_(0), size_(0) {
+      std::random_device seed;
+      std::mt19937_64 random((uint64_t(seed()) << 32) | seed());
+      base_ = 256 + random() % (detail::hash_modulus - 512);
+    }
+
+    hash_index(hash_index const &) = delete;
+    hash_index &operator=(hash_index const &) = delete;
+
+    // The number of elements in the chain.
+    size_t size() const {
+      build();
+      return size_;
+    }
+
+    // Whether the slice [first, first_end) is equal to the slice
+    // [second, second_end) of the chain. Both have to be within the chain.
+    bool equal(size_t first, size_t first_end,
+               size_t second, size_t second_end) const {
+      build();
+      assert(first <= first_end && first_end <= size_);
+      assert(second <= second_end && second_end <= size_);
+      if (first_end - first != second_end - second) return false;
+      if (first == second) return true;
+      return hash(first, first_end - first) == hash(second, second_end - second);
+    }
+
+    // The length of the longest common extension of the two positions, which
+    // is the longest length such that the slices starting at first and second
+    // with that length are equal.
+    size_t common_extension(size_t first, size_t second) const {
+      build();
+      assert(first <= size_ && second <= size_);
+      if (first == second) return size_ - first;
+      size_t low = 0, high = size_ - std::max(first, second);
+      while (low < high) {
+        size_t middle = low + (high - low + 1) / 2;
+        if (hash(first, middle) == hash(second, middle)) {
+          low = middle;
+        } else {
+          high = middle - 1;
+        }
+      }
+      return low;
+    }
+
+    // How many bytes the index itself takes up, not counting the chain. This
+    // is zero until the index has been built.
+    size_t memory_usage() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return sizeof(uint64_t) *
+             (prefix_.capacity() + low_powers_.capacity() + high_powers_.capacity());
+    }
+
+   private:
+    // Powers of the base are split into a table of the low 16 bits of the
+    // exponent and a table of the rest so that we don't need a power for every
+    // position in the chain.
+    static size_t const low_bits = 16;
+
+    chain_t<Element, Allocator> chain_;
+    thread_pool &pool_;
+    uint64_t base_;
+    mutable std::once_flag built_;
+    mutable std::mutex mutex_;
+    mutable size_t size_;
+    // prefix_[i] is the hash of the first i elements of the chain.
+    mutable std::vector<uint64_t> prefix_, low_powers_, high_powers_;
+
+    uint64_t power(size_t exponent) const {
+      return detail::hash_multiply(
+          high_powers_[exponent >> low_bits],
+          low_powers_[exponent & ((size_t(1) << low_bits) - 1)]);
+    }
+
+    static uint64_t element_value(Element e) {
+      return static_cast<typename std::make_unsigned<Element>::type>(e) + 1;
+    }
+
+    uint64_t hash(size_t position, size_t length) const {
+      return detail::hash_subtract(
+          prefix_[position + length],
+          detail::hash_multiply(prefix_[position], power(length)));
+    }
+
+    void build() const {
+      std::call_once(built_, [this] { build_now(); });
+    }
+
+    // Every task first hashes its own part of the chain as if it started at
+    // the beginning. Once we know the hash of everything before each part, a
+    // second pass over the parts in parallel shifts their hashes into place.
+    void build_now() const {
+      detail::partition<Element> parts(detail::chain_access::links(chain_),
+                                       pool_.size());
+      std::lock_guard<std::mutex> lock(mutex_);
+      size_ = parts.total;
+      prefix_.assign(size_ + 1, 0);
+      low_powers_.resize(size_t(1) << low_bits);
+      high_powers_.resize((size_ >> low_bits) + 1);
+      low_powers_[0] = 1;
+      for (size_t i = 1; i < low_powers_.size(); ++i) {
+        low_powers_[i] = detail::hash_multiply(low_powers_[i - 1], base_);
+      }
+      uint64_t step = detail::hash_multiply(low_powers_.back(), base_);
+      high_powers_[0] = 1;
+      for (size_t i = 1; i < high_powers_.size(); ++i) {
+        high_powers_[i] = detail::hash_multiply(high_powers_[i - 1], step);
+      }
+
+      pool_.run(parts.task_count(), [&](size_t t) {
+        uint64_t h = 0;
+        for (auto s = parts.begin(t); s != parts.end(t); ++s) {
+          uint64_t *out = prefix_.data() + s->position + 1;
+          for (size_t i = 0; i < s->length; ++i) {
+            h = detail::hash_add(detail::hash_multiply(h, base_),
+                                 element_value(s->data[i]));
+            out[i] = h;
+          }
+        }
+      });
+
+      std::vector<uint64_t> carried(parts.task_count(), 0);
+      std::vector<size_t> starts(parts.task_count(), 0), ends(parts.task_count(), 0);
+      uint64_t before = 0;
+      for (size_t t = 0; t < parts.task_count(); ++t) {
+        if (parts.begin(t) == parts.end(t)) continue;
+        starts[t] = parts.begin(t)->position;
+        ends[t] = (parts.end(t) - 1)->position + (parts.end(t) - 1)->length;
+        carried[t] = before;
+        uint64_t local = prefix_[ends[t]];
+        before = detail::hash_add(
+            detail::hash_multiply(before, power(ends[t] - starts[t])), local);
+      }
+
+      pool_.run(parts.task_count(), [&](size_t t) {
+        if (!carried[t]) return;
+        uint64_t shift = carried[t];
+        for (size_t p = starts[t] + 1; p <= ends[t]; ++p) {
+          shift = detail::hash_multiply(shift, base_);
+          prefix_[p] = detail::hash_add(prefix_[p], shift);
+        }
+      });
+    }
+  };
+
+}  // namespace chain
+
+#endif  // CHAIN_HASH_INDEX_HPP
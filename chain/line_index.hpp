@@ -0,0 +1,313 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// line_index.hpp
+//
+#ifndef CHAIN_LINE_INDEX_HPP
+#define CHAIN_LINE_INDEX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <chain/chain.hpp>
+
+namespace chain {
+
+  namespace detail {
+    // Where the newlines are in the part of a block that's been scanned so
+    // far, in windows of a fixed number of elements each. Windows never change
+    // once they're handed out, so scanning further into a block only makes a
+    // new copy of the window the last scan stopped in and shares the rest.
+    struct newline_positions {
+      typedef std::vector<uint32_t> window_type;
+
+      static size_t const window_size = size_t(1) << 16;
+
+      std::vector<std::shared_ptr<window_type const>> windows;
+      // The number of newlines before each window, and in all of them.
+      std::vector<size_t> before;
+      size_t count;
+
+      newline_positions() : count(0) {}
+
+      // The number of newlines before the offset into the block, which has to
+      // be within what's been scanned.
+      size_t rank(size_t offset) const {
+        size_t w = offset / window_size;
+        if (w >= windows.size()) return count;
+        window_type const &window = *windows[w];
+        return before[w] + (std::lower_bound(window.begin(), window.end(), offset) -
+                            window.begin());
+      }
+
+      // Where newline number r in the block is.
+      size_t select(size_t r) const {
+        size_t w = std::upper_bound(before.begin(), before.end(), r) - before.begin() - 1;
+        return (*windows[w])[r - before[w]];
+      }
+    };
+
+    // The newline cache knows where the newlines are in every block that an
+    // index sharing it has looked at. A block is only scanned the first time
+    // an index needs it, and only as far as any link to it goes; since
+    // elements don't change once they're in a block, what we found stays true
+    // for as long as the block is around, which the cache makes sure of by
+    // holding a reference to it. The positions we hand out never change
+    // either: scanning further into a block makes new positions that share
+    // all but the last window with the ones we had.
+    template <class Element, class Allocator>
+    class newline_cache {
+      typedef block<Element, Allocator> block_type;
+
+     public:
+      typedef newline_positions positions;
+      typedef std::shared_ptr<positions const> shared_positions;
+
+      newline_cache() {}
+      newline_cache(newline_cache const &) = delete;
+      newline_cache &operator=(newline_cache const &) = delete;
+
+      ~newline_cache() {
+        for (auto &e : entries_) block_type::release(e.first);
+      }
+
+      // The positions of the newlines in the block before the given offset,
+      // and perhaps some after it.
+      shared_positions newlines(block_type *b, size_t before) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = entries_.find(b);
+        if (found == entries_.end()) {
+          found = entries_.emplace(b, entry()).first;
+          block_type::acquire(b);
+        }
+        entry &e = found->second;
+        if (!e.newlines || e.scanned < before) {
+          std::shared_ptr<positions> more = e.newlines
+              ? std::make_shared<positions>(*e.newlines)
+              : std::make_shared<positions>();
+          for (size_t from = e.scanned; from < before;) {
+            size_t w = from / positions::window_size;
+            size_t to = std::min(before, (w + 1) * positions::window_size);
+            std::shared_ptr<positions::window_type> window;
+            if (w < more->windows.size()) {
+              window = std::make_shared<positions::window_type>(*more->windows[w]);
+            } else {
+              window = std::make_shared<positions::window_type>();
+              more->before.push_back(more->count);
+            }
+            size_t had = window->size();
+            find_all_elements(b->data() + from, to - from, Element('\n'), *window,
+                              from);
+            more->count += window->size() - had;
+            if (w < more->windows.size()) {
+              more->windows[w] = std::move(window);
+            } else {
+              more->windows.push_back(std::move(window));
+            }
+            from = to;
+          }
+          e.newlines = std::move(more);
+          e.scanned = std::max(e.scanned, before);
+        }
+        return e.newlines;
+      }
+
+      // Takes on what another cache found out, so that indexes of chains made
+      // of the chains both caches know about don't scan anything again.
+      void merge(newline_cache &other) {
+        if (&other == this) return;
+        std::lock(mutex_, other.mutex_);
+        std::lock_guard<std::mutex> ours(mutex_, std::adopt_lock);
+        std::lock_guard<std::mutex> theirs(other.mutex_, std::adopt_lock);
+        for (auto const &e : other.entries_) {
+          auto found = entries_.find(e.first);
+          if (found == entries_.end()) {
+            entries_.emplace(e.first, e.second);
+            block_type::acquire(e.first);
+          } else if (found->second.scanned < e.second.scanned) {
+            found->second = e.second;
+          }
+        }
+      }
+
+     private:
+      struct entry {
+        shared_positions newlines;
+        size_t scanned;
+        entry() : scanned(0) {}
+      };
+
+      std::mutex mutex_;
+      std::unordered_map<block_type *, entry> entries_;
+    };
+  }  // namespace detail
+
+  // A line index answers which line an offset into a chain is on, and where
+  // a given line is, in time logarithmic in the size of the chain. Lines are
+  // numbered from zero and are what splitting the chain on newlines gives:
+  // a chain with n newlines has n + 1 lines, and a chain that points to
+  // nothing has none.
+  //
+  // Chains don't carry an index unless one is made for them. Making one looks
+  // up where the newlines are in each block the chain refers to and sums up
+  // how many there are across its links. The positions are kept per block in
+  // a cache shared by an index and the indexes made from it, so indexing a
+  // slice of an indexed chain, or a concatenation of indexed chains, only
+  // takes time in the number of links and doesn't scan any block again.
+  //
+  //   chain::line_index<chain::chain> lines(log);
+  //   chain::chain line = lines.line(41);
+  //   size_t which = lines.line_of(offset);
+  //   auto tail = lines.slice(offset, log.size() - offset);
+  //
+  // Indexes don't change once they're made, so they can be queried from any
+  // number of threads at once.
+  template <class Chain>
+  class line_index;
+
+  template <class Element, class Allocator>
+  class line_index<chain_t<Element, Allocator>> {
+    typedef chain_t<Element, Allocator> chain_type;
+    typedef detail::block_links<Element, Allocator> links_type;
+    typedef detail::newline_cache<Element, Allocator> cache_type;
+    typedef typename cache_type::shared_positions shared_positions;
+
+   public:
+    explicit line_index(chain_type const &c)
+    : chain_(c), cache_(std::make_shared<cache_type>()) {
+      build();
+    }
+
+    // Indexes the chain using what the other index already found out about
+    // the blocks they have in common.
+    line_index(chain_type const &c, line_index const &sharing)
+    : chain_(c), cache_(sharing.cache_) {
+      build();
+    }
+
+    chain_type const &contents() const { return chain_; }
+
+    size_t line_count() const {
+      return detail::chain_access::links(chain_) == nullptr ? 0
+                                                            : lines_before_.back() + 1;
+    }
+
+    // The line the element at offset is on, where an offset at the end of
+    // the chain is on the last line. A newline is on the line it ends.
+    size_t line_of(size_t offset) const {
+      assert(offset <= chain_.size() && "Invalid offset.");
+      if (newlines_.empty()) return 0;
+      size_t i = std::upper_bound(elements_before_.begin(), elements_before_.end(),
+                                  offset) - elements_before_.begin() - 1;
+      i = std::min(i, newlines_.size() - 1);
+      size_t position = start(i) + (offset - elements_before_[i]);
+      return lines_before_[i] + (newlines_[i]->rank(position) - first_newline_[i]);
+    }
+
+    // The offset of the first element of the line.
+    size_t line_offset(size_t line) const {
+      assert(line < line_count() && "Invalid line.");
+      if (line == 0) return 0;
+      // The line starts right after newline number line - 1 in the chain.
+      size_t newline = line - 1;
+      size_t i = std::upper_bound(lines_before_.begin(), lines_before_.end(),
+                                  newline) - lines_before_.begin() - 1;
+      size_t position =
+          newlines_[i]->select(first_newline_[i] + newline - lines_before_[i]);
+      return elements_before_[i] + (position - start(i)) + 1;
+    }
+
+    // The line as a slice of the chain, without the newline that ends it.
+    chain_type line(size_t line) const {
+      size_t begin = line_offset(line);
+      size_t end = line + 1 < line_count() ? line_offset(line + 1) - 1 : chain_.size();
+      return part(begin, end);
+    }
+
+    // The index of a slice of the chain, which shares what this index found.
+    line_index slice(size_t offset, size_t length) const {
+      return line_index(chain_.slice(offset, length), *this);
+    }
+
+    // The index of the concatenation of the chains, which shares what both
+    // indexes found.
+    friend line_index operator+(line_index const &l, line_index const &r) {
+      l.cache_->merge(*r.cache_);
+      return line_index(l.chain_ + r.chain_, l);
+    }
+
+   private:
+    chain_type chain_;
+    std::shared_ptr<cache_type> cache_;
+    // For every link, the number of elements and of newlines in the links
+    // before it, with the totals at the end, then where the newlines of the
+    // link's block are and which of them is the first one in the link.
+    std::vector<size_t> elements_before_, lines_before_;
+    std::vector<shared_positions> newlines_;
+    std::vector<uint32_t> first_newline_;
+
+    // Where link i starts in its block.
+    uint32_t start(size_t i) const {
+      return detail::chain_access::links(chain_)->begin()[i].offset;
+    }
+
+    // The elements from begin up to before end, made only from the links
+    // they're in instead of slicing the whole chain.
+    chain_type part(size_t begin, size_t end) const {
+      Allocator *allocator = detail::chain_access::allocator(chain_);
+      links_type const *links = detail::chain_access::links(chain_);
+      links_type *piece = links_type::make(allocator);
+      try {
+        size_t i = std::upper_bound(elements_before_.begin(), elements_before_.end(),
+                                    begin) - elements_before_.begin() - 1;
+        for (; begin < end; ++i) {
+          auto const &link = links->begin()[i];
+          size_t offset = begin - elements_before_[i];
+          size_t length = std::min<size_t>(link.length - offset, end - begin);
+          links_type::block_type::acquire(link.target);
+          piece->push_link(link.target, link.offset + offset, length);
+          begin += length;
+        }
+      } catch (...) {
+        links_type::release(piece);
+        throw;
+      }
+      return detail::chain_access::make(allocator, piece);
+    }
+
+    void build() {
+      links_type const *links = detail::chain_access::links(chain_);
+      size_t elements = 0, lines = 0;
+      if (links != nullptr) {
+        size_t count = links->link_count();
+        elements_before_.reserve(count + 1);
+        lines_before_.reserve(count + 1);
+        newlines_.reserve(count);
+        first_newline_.reserve(count);
+        for (auto const &link : *links) {
+          shared_positions block =
+              cache_->newlines(link.target, size_t(link.offset) + link.length);
+          size_t first = block->rank(link.offset);
+          size_t last = block->rank(size_t(link.offset) + link.length);
+          elements_before_.push_back(elements);
+          lines_before_.push_back(lines);
+          first_newline_.push_back(static_cast<uint32_t>(first));
+          newlines_.push_back(std::move(block));
+          elements += link.length;
+          lines += last - first;
+        }
+      }
+      elements_before_.push_back(elements);
+      lines_before_.push_back(lines);
+    }
+  };
+
+}  // namespace chain
+
+#endif  // CHAIN_LINE_INDEX_HPP
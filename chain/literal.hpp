@@ -0,0 +1,193 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// literal.hpp
+//
+#ifndef CHAIN_LITERAL_HPP
+#define CHAIN_LITERAL_HPP
+
+#include <cstdint>
+#include <type_traits>
+
+#include <chain/chain.hpp>
+
+namespace chain {
+
+  namespace detail {
+    // Content hashes are polynomials in a fixed odd base modulo 2^64, run
+    // through a finalizer that spreads every bit of the polynomial over all of
+    // the bits of the hash. The polynomial of a run is the polynomial of its
+    // first half shifted by the length of the second half plus the polynomial
+    // of the second half, which lets us work out the hash of a literal at
+    // compile time without recursing once per element.
+    uint64_t const content_hash_base = 0x100000001b3ULL;
+
+    template <class Element>
+    constexpr uint64_t content_value(Element e) {
+      return static_cast<uint64_t>(
+                 static_cast<typename std::make_unsigned<Element>::type>(e)) + 1;
+    }
+
+    constexpr uint64_t content_power(uint64_t base, size_t exponent) {
+      return exponent == 0 ? 1
+                           : (exponent & 1 ? base : 1) *
+                                 content_power(base * base, exponent >> 1);
+    }
+
+    template <class Element>
+    constexpr uint64_t content_polynomial(Element const *elements, size_t length) {
+      return length == 0 ? 0
+           : length == 1 ? content_value(elements[0])
+           : content_polynomial(elements, length / 2) *
+                     content_power(content_hash_base, length - length / 2) +
+                 content_polynomial(elements + length / 2, length - length / 2);
+    }
+
+    constexpr uint64_t content_shift(uint64_t h, unsigned bits) {
+      return h ^ (h >> bits);
+    }
+
+    constexpr uint64_t content_finish(uint64_t polynomial) {
+      return content_shift(
+          content_shift(content_shift(polynomial, 33) * 0xff51afd7ed558ccdULL, 33) *
+              0xc4ceb9fe1a85ec53ULL,
+          33);
+    }
+
+    template <class Element>
+    constexpr uint64_t content_hash(Element const *elements, size_t length) {
+      return content_finish(content_polynomial(elements, length));
+    }
+  }  // namespace detail
+
+  // A chain literal is what the compiler knows about a string literal: where
+  // its elements are, how many of them there are, and the hash of its
+  // contents. All of that is worked out at compile time, so a chain literal
+  // declared constexpr sits in read-only storage and comparing chains against
+  // it or looking it up by its hash doesn't scan or hash the literal at run
+  // time.
+  //
+  //   using namespace chain::literals;
+  //   constexpr chain::chain_literal get = "GET"_chain;
+  //   if (method == get) ...
+  template <class Element>
+  class basic_chain_literal {
+   public:
+    template <size_t N>
+    constexpr basic_chain_literal(Element const (&literal)[N])
+    : elements_(literal), size_(N > 0 ? N - 1 : 0)
+    , hash_(detail::content_hash(literal, N > 0 ? N - 1 : 0)) {}
+
+    constexpr basic_chain_literal(Element const *elements, size_t length)
+    : elements_(elements), size_(length)
+    , hash_(detail::content_hash(elements, length)) {}
+
+    constexpr Element const *data() const { return elements_; }
+    constexpr size_t size() const { return size_; }
+    constexpr uint64_t hash() const { return hash_; }
+
+    // Makes a chain with the same contents. Like chains made from strings, we
+    // make the links before copying the contents into blocks.
+    template <class Allocator = std::allocator<Element>>
+    chain_t<Element, Allocator> chain() const {
+      typedef detail::block_links<Element, Allocator> links_type;
+      chain_t<Element, Allocator> defaulted;
+      Allocator *allocator = detail::chain_access::allocator(defaulted);
+      links_type *links = links_type::make(allocator);
+      try {
+        links->append(
+            links_type::block_type::get_block(elements_, size_, allocator));
+      } catch (...) {
+        links_type::release(links);
+        throw;
+      }
+      return detail::chain_access::make(allocator, links);
+    }
+
+   private:
+    Element const *elements_;
+    size_t size_;
+    uint64_t hash_;
+  };
+
+  typedef basic_chain_literal<char> chain_literal;
+  typedef basic_chain_literal<char16_t> u16chain_literal;
+  typedef basic_chain_literal<char32_t> u32chain_literal;
+
+  inline namespace literals {
+    constexpr chain_literal operator"" _chain(char const *s, size_t n) {
+      return chain_literal(s, n);
+    }
+
+    constexpr u16chain_literal operator"" _chain(char16_t const *s, size_t n) {
+      return u16chain_literal(s, n);
+    }
+
+    constexpr u32chain_literal operator"" _chain(char32_t const *s, size_t n) {
+      return u32chain_literal(s, n);
+    }
+  }  // namespace literals
+
+  // The hash of the contents of a chain, which is the same as the hash of a
+  // literal with the same contents. A chain that points to nothing hashes the
+  // same as an empty one.
+  template <class Element, class Allocator>
+  uint64_t content_hash(chain_t<Element, Allocator> const &c) {
+    detail::block_links<Element, Allocator> const *links =
+        detail::chain_access::links(c);
+    uint64_t polynomial = 0;
+    if (links != nullptr) {
+      for (auto const &link : *links) {
+        Element const *data = link.data();
+        for (uint32_t i = 0; i < link.length; ++i) {
+          polynomial = polynomial * detail::content_hash_base +
+                       detail::content_value(data[i]);
+        }
+      }
+    }
+    return detail::content_finish(polynomial);
+  }
+
+  // Comparing a chain against a literal first looks at the length the chain
+  // and the literal already know, and only then at the elements, link by link,
+  // without making a chain out of the literal. A chain that points to nothing
+  // isn't equal to any literal, not even an empty one.
+  template <class Element, class Allocator>
+  bool operator==(chain_t<Element, Allocator> const &c,
+                  basic_chain_literal<Element> const &literal) {
+    detail::block_links<Element, Allocator> const *links =
+        detail::chain_access::links(c);
+    if (links == nullptr || links->size() != literal.size()) return false;
+    Element const *elements = literal.data();
+    for (auto const &link : *links) {
+      if (detail::compare_elements(link.data(), elements, link.length)) {
+        return false;
+      }
+      elements += link.length;
+    }
+    return true;
+  }
+
+  template <class Element, class Allocator>
+  bool operator==(basic_chain_literal<Element> const &literal,
+                  chain_t<Element, Allocator> const &c) {
+    return c == literal;
+  }
+
+  template <class Element, class Allocator>
+  bool operator!=(chain_t<Element, Allocator> const &c,
+                  basic_chain_literal<Element> const &literal) {
+    return !(c == literal);
+  }
+
+  template <class Element, class Allocator>
+  bool operator!=(basic_chain_literal<Element> const &literal,
+                  chain_t<Element, Allocator> const &c) {
+    return !(c == literal);
+  }
+
+}  // namespace chain
+
+#endif  // CHAIN_LITERAL_HPP
@@ -0,0 +1,185 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// literal_set.hpp
+//
+#ifndef CHAIN_LITERAL_SET_HPP
+#define CHAIN_LITERAL_SET_HPP
+
+#if __cplusplus < 201402L
+#error "Literal sets are built at compile time with C++14 constexpr."
+#endif
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <chain/literal.hpp>
+
+namespace chain {
+
+  namespace detail {
+    // The slot a hash goes to in a table with the given mask, for the seed of
+    // the bucket the hash falls into. Buckets are picked by the low bits of the
+    // hash itself, while the slots come from mixing the hash with the seed
+    // again.
+    constexpr size_t literal_slot(uint64_t hash, uint32_t seed, size_t mask) {
+      return static_cast<size_t>(
+          content_finish(hash ^ (seed * 0x9e3779b97f4a7c15ULL)) & mask);
+    }
+
+    constexpr size_t literal_table_size(size_t n) {
+      size_t size = 1;
+      while (size < n) size <<= 1;
+      return size;
+    }
+
+    template <class Element>
+    constexpr bool same_literal(basic_chain_literal<Element> const &l,
+                                basic_chain_literal<Element> const &r) {
+      if (l.size() != r.size()) return false;
+      for (size_t i = 0; i < l.size(); ++i) {
+        if (l.data()[i] != r.data()[i]) return false;
+      }
+      return true;
+    }
+  }  // namespace detail
+
+  // A literal set is a perfect hash table over a fixed list of literals that's
+  // built at compile time. Every literal hashes into a bucket, and every
+  // bucket has a seed that sends all the literals in it to slots of their own,
+  // so finding which literal a chain is, if any, takes hashing the chain once,
+  // looking at a single slot, and comparing the chain to the one literal in
+  // it, no matter how many literals there are.
+  //
+  //   constexpr auto methods = chain::make_literal_set(
+  //       "GET"_chain, "HEAD"_chain, "POST"_chain, "PUT"_chain);
+  //   switch (methods.find(method)) { case 0: ... }
+  //
+  // The literals have to be different from each other; listing one twice
+  // fails to compile when the set is constexpr, and throws otherwise.
+  template <class Element, size_t N>
+  class basic_literal_set {
+    static_assert(N > 0, "Literal sets need at least one literal.");
+
+   public:
+    typedef basic_chain_literal<Element> literal_type;
+
+    static size_t const npos = static_cast<size_t>(-1);
+
+    template <class... Literals>
+    constexpr explicit basic_literal_set(Literals const &... literals)
+    : literals_{literal_type(literals)...} {
+      static_assert(sizeof...(Literals) == N, "Give exactly N literals.");
+      build();
+    }
+
+    constexpr size_t size() const { return N; }
+    constexpr literal_type const &operator[](size_t i) const { return literals_[i]; }
+
+    // The position of the literal in the list the set was made from, or npos
+    // if it's not one of them.
+    template <class Allocator>
+    size_t find(chain_t<Element, Allocator> const &c) const {
+      if (detail::chain_access::links(c) == nullptr) return npos;
+      uint64_t hash = content_hash(c);
+      size_t i = candidate(hash);
+      if (i == npos || literals_[i].hash() != hash) return npos;
+      return c == literals_[i] ? i : npos;
+    }
+
+    constexpr size_t find(literal_type const &literal) const {
+      size_t i = candidate(literal.hash());
+      if (i == npos || !detail::same_literal(literals_[i], literal)) return npos;
+      return i;
+    }
+
+    template <class Allocator>
+    bool contains(chain_t<Element, Allocator> const &c) const {
+      return find(c) != npos;
+    }
+
+   private:
+    static size_t const table_size = detail::literal_table_size(N);
+    static size_t const mask = table_size - 1;
+    // Nobody should need more seeds than this for a bucket, with every bucket
+    // holding about one literal.
+    static uint32_t const seed_limit = 1 << 20;
+
+    literal_type literals_[N];
+    uint32_t seeds_[table_size] = {};
+    // The literal in each slot, or npos if the slot is free.
+    size_t slots_[table_size] = {};
+
+    constexpr size_t candidate(uint64_t hash) const {
+      return slots_[detail::literal_slot(hash, seeds_[hash & mask], mask)];
+    }
+
+    // We place the buckets with the most literals first, while there are the
+    // most free slots, trying seeds for each of them in turn until every
+    // literal in the bucket lands on a free slot.
+    constexpr void build() {
+      size_t sizes[table_size] = {};
+      for (size_t s = 0; s < table_size; ++s) slots_[s] = npos;
+      for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+          if (detail::same_literal(literals_[i], literals_[j])) {
+            throw std::logic_error("The same literal is in the set twice.");
+          }
+        }
+        ++sizes[literals_[i].hash() & mask];
+      }
+      for (size_t size = N; size > 0; --size) {
+        for (size_t b = 0; b < table_size; ++b) {
+          if (sizes[b] == size) place(b);
+        }
+      }
+    }
+
+    constexpr void place(size_t bucket) {
+      for (uint32_t seed = 0; seed < seed_limit; ++seed) {
+        size_t placed = 0;
+        bool fits = true;
+        for (size_t i = 0; i < N && fits; ++i) {
+          uint64_t hash = literals_[i].hash();
+          if ((hash & mask) != bucket) continue;
+          size_t slot = detail::literal_slot(hash, seed, mask);
+          if (slots_[slot] != npos) {
+            fits = false;
+          } else {
+            slots_[slot] = i;
+            ++placed;
+          }
+        }
+        if (fits) {
+          seeds_[bucket] = seed;
+          return;
+        }
+        // We give back the slots we took for this seed before the next one.
+        for (size_t i = 0; i < N && placed; ++i) {
+          uint64_t hash = literals_[i].hash();
+          if ((hash & mask) != bucket) continue;
+          size_t slot = detail::literal_slot(hash, seed, mask);
+          if (slots_[slot] == i) {
+            slots_[slot] = npos;
+            --placed;
+          }
+        }
+      }
+      throw std::logic_error("Couldn't find a perfect hash for the literals.");
+    }
+  };
+
+  template <class Element, size_t N>
+  size_t const basic_literal_set<Element, N>::npos;
+
+  template <class Element, class... Rest>
+  constexpr basic_literal_set<Element, 1 + sizeof...(Rest)>
+  make_literal_set(basic_chain_literal<Element> const &first, Rest const &... rest) {
+    return basic_literal_set<Element, 1 + sizeof...(Rest)>(first, rest...);
+  }
+
+}  // namespace chain
+
+#endif  // CHAIN_LITERAL_SET_HPP
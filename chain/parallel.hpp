@@ -0,0 +1,213 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// parallel.hpp
+//
+#ifndef CHAIN_PARALLEL_HPP
+#define CHAIN_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+#include <chain/chain.hpp>
+#include <chain/thread_pool.hpp>
+
+namespace chain {
+
+  namespace detail {
+    // A contiguous run of elements in a chain, along with where it starts in
+    // the chain.
+    template <class Element>
+    struct span {
+      Element const *data;
+      size_t length;
+      size_t position;
+    };
+
+    // Every link in a chain is an independent contiguous run of elements,
+    // which makes them a natural unit of work. Links can be anything from a
+    // few elements long to as long as a whole adopted buffer though, so we cut
+    // long links into runs of roughly equal size and group consecutive short
+    // ones together into tasks of about that size, a few per thread so that
+    // stealing has something to even out.
+    template <class Element>
+    struct partition {
+      std::vector<span<Element>> spans;
+      // Task t covers spans[tasks[t]] up to spans[tasks[t + 1]].
+      std::vector<size_t> tasks;
+      size_t total;
+
+      template <class Allocator>
+      partition(block_links<Element, Allocator> const *links, unsigned threads)
+      : spans(), tasks(1, 0), total(0) {
+        if (links == nullptr) return;
+        size_t const tasks_per_thread = 8;
+        size_t grain = std::max<size_t>(
+            1, links->size() / (static_cast<size_t>(threads) * tasks_per_thread));
+        spans.reserve(links->link_count());
+        size_t accumulated = 0;
+        for (auto const &link : *links) {
+          for (size_t offset = 0; offset < link.length;) {
+            size_t length = std::min<size_t>(link.length - offset, grain);
+            spans.push_back(span<Element>{link.data() + offset, length, total});
+            total += length;
+            offset += length;
+            accumulated += length;
+            if (accumulated >= grain) {
+              tasks.push_back(spans.size());
+              accumulated = 0;
+            }
+          }
+        }
+        if (tasks.back() != spans.size()) tasks.push_back(spans.size());
+      }
+
+      size_t task_count() const { return tasks.size() - 1; }
+
+      span<Element> const *begin(size_t t) const { return spans.data() + tasks[t]; }
+      span<Element> const *end(size_t t) const { return spans.data() + tasks[t + 1]; }
+    };
+
+    inline thread_pool &default_pool() {
+      static thread_pool pool;
+      return pool;
+    }
+  }  // namespace detail
+
+  // The parallel algorithms only read the blocks of the chains they're given,
+  // so the chains must stay alive until they return, but they're otherwise free
+  // to be shared with other threads that are only reading them too. Every
+  // algorithm takes an optional thread pool, and uses a pool shared by the
+  // whole program with as many threads as there are cores if none is given.
+
+  // A position past the end of any chain, for when we don't find what we're
+  // looking for.
+  size_t const npos = std::numeric_limits<size_t>::max();
+
+  // Counts the elements in the chain that are equal to value.
+  template <class Element, class Allocator>
+  size_t parallel_count(chain_t<Element, Allocator> const &c, Element value,
+                        thread_pool &pool = detail::default_pool()) {
+    detail::partition<Element> parts(detail::chain_access::links(c), pool.size());
+    std::vector<size_t> counts(parts.task_count());
+    pool.run(parts.task_count(), [&](size_t t) {
+      size_t count = 0;
+      for (auto s = parts.begin(t); s != parts.end(t); ++s) {
+        count += std::count(s->data, s->data + s->length, value);
+      }
+      counts[t] = count;
+    });
+    size_t total = 0;
+    for (size_t count : counts) total += count;
+    return total;
+  }
+
+  // Finds the position of the first element in the chain that is equal to
+  // value, or npos if there isn't one. Tasks that start after something has
+  // already been found don't bother looking.
+  template <class Element, class Allocator>
+  size_t parallel_find(chain_t<Element, Allocator> const &c, Element value,
+                       thread_pool &pool = detail::default_pool()) {
+    detail::partition<Element> parts(detail::chain_access::links(c), pool.size());
+    std::atomic<size_t> first(npos);
+    pool.run(parts.task_count(), [&](size_t t) {
+      for (auto s = parts.begin(t); s != parts.end(t); ++s) {
+        if (s->position >= first.load(std::memory_order_relaxed)) return;
+        size_t found = detail::find_element(s->data, s->length, value);
+        if (found != s->length) {
+          size_t position = s->position + found;
+          size_t current = first.load(std::memory_order_relaxed);
+          while (position < current &&
+                 !first.compare_exchange_weak(current, position)) {}
+          return;
+        }
+      }
+    });
+    return first.load();
+  }
+
+  // Builds a new chain by applying transform to every element of the chain.
+  // Every task writes its part of the result into pages of its own, which are
+  // then linked together in order; the transform may be called from several
+  // threads at once, and so may the allocator.
+  template <class Element, class Allocator, class Transform>
+  chain_t<Element, Allocator>
+  parallel_transform(chain_t<Element, Allocator> const &c, Transform transform,
+                     thread_pool &pool = detail::default_pool()) {
+    typedef detail::block_links<Element, Allocator> links_type;
+    typedef detail::block_writer<Element, Allocator> writer_type;
+    Allocator *allocator = detail::chain_access::allocator(c);
+    links_type const *links = detail::chain_access::links(c);
+    if (links == nullptr) return chain_t<Element, Allocator>(allocator);
+    detail::partition<Element> parts(links, pool.size());
+    std::vector<links_type *> results(parts.task_count(), nullptr);
+    struct release_results {
+      std::vector<links_type *> &results;
+      ~release_results() {
+        for (links_type *l : results) links_type::release(l);
+      }
+    } cleanup{results};
+    pool.run(parts.task_count(), [&](size_t t) {
+      writer_type writer(allocator, writer_type::exclusive_pages);
+      for (auto s = parts.begin(t); s != parts.end(t); ++s) {
+        Element const *first = s->data, *last = s->data + s->length;
+        while (first != last) {
+          size_t available;
+          Element *destination = writer.window(available);
+          size_t segment = std::min<size_t>(available, last - first);
+          std::transform(first, first + segment, destination, transform);
+          writer.advance(segment);
+          first += segment;
+        }
+      }
+      results[t] = writer.finish();
+    });
+    links_type *combined = links_type::make(allocator);
+    try {
+      for (links_type *l : results) combined->splice(*l);
+    } catch (...) {
+      links_type::release(combined);
+      throw;
+    }
+    return detail::chain_access::make(allocator, combined);
+  }
+
+  // Combines all the elements of the chain, starting with init, using reduce.
+  // Since the elements are combined in separate groups at the same time,
+  // reduce has to be associative, though it needn't be commutative.
+  template <class T, class Element, class Allocator, class Reduce>
+  T parallel_reduce(chain_t<Element, Allocator> const &c, T init, Reduce reduce,
+                    thread_pool &pool = detail::default_pool()) {
+    detail::partition<Element> parts(detail::chain_access::links(c), pool.size());
+    std::vector<T> partials(parts.task_count(), init);
+    std::vector<char> nonempty(parts.task_count(), 0);
+    pool.run(parts.task_count(), [&](size_t t) {
+      bool started = false;
+      T accumulated = init;
+      for (auto s = parts.begin(t); s != parts.end(t); ++s) {
+        for (size_t i = 0; i < s->length; ++i) {
+          if (started) {
+            accumulated = reduce(accumulated, T(s->data[i]));
+          } else {
+            accumulated = T(s->data[i]);
+            started = true;
+          }
+        }
+      }
+      partials[t] = accumulated;
+      nonempty[t] = started;
+    });
+    T result = init;
+    for (size_t t = 0; t < partials.size(); ++t) {
+      if (nonempty[t]) result = reduce(result, partials[t]);
+    }
+    return result;
+  }
+
+}  // namespace chain
+
+#endif  // CHAIN_PARALLEL_HPP
@@ -0,0 +1,54 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// pmr.hpp
+//
+#ifndef CHAIN_PMR_HPP
+#define CHAIN_PMR_HPP
+
+#if __cplusplus < 201703L
+#error "Chains on memory resources need std::pmr from C++17."
+#endif
+
+#include <memory_resource>
+
+#include <chain/chain.hpp>
+
+namespace chain {
+
+  namespace detail {
+    // Memory resources are arenas: a monotonic buffer resource lets go of
+    // everything at once, and any resource may go away before the program
+    // does. Chains on memory resources get everything they need from the
+    // resource, and none of their pages are left behind for the next chain.
+    template <class T>
+    struct arena_allocator<std::pmr::polymorphic_allocator<T>> : std::true_type {};
+  }  // namespace detail
+
+  // The pmr chains allocate their blocks, the headers of their blocks, and
+  // their links from the memory resource of the allocator they're given. The
+  // allocator and its resource have to outlive the chains, after which the
+  // resource can be released in one go. Chains constructed without an
+  // allocator use the default memory resource.
+  //
+  //   std::pmr::monotonic_buffer_resource arena;
+  //   std::pmr::polymorphic_allocator<char> allocator(&arena);
+  //   chain::pmr::chain c(std::pmr::string("Hello", &arena), &allocator);
+  //
+  // Swapping chains whose resources are the same swaps their links, while
+  // chains on different resources copy their contents into each other's.
+  namespace pmr {
+    template <class Element>
+    using chain_t = ::chain::chain_t<Element, std::pmr::polymorphic_allocator<Element>>;
+
+    typedef chain_t<char32_t> u32chain;
+    typedef chain_t<char16_t> u16chain;
+    typedef chain_t<unsigned char> u8chain;
+    typedef chain_t<char> chain;
+  }  // namespace pmr
+
+}  // namespace chain
+
+#endif  // CHAIN_PMR_HPP
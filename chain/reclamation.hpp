@@ -0,0 +1,57 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// reclamation.hpp
+//
+#ifndef CHAIN_RECLAMATION_HPP
+#define CHAIN_RECLAMATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <chain/chain.hpp>
+
+namespace chain {
+
+  // A background reclaimer gives the pages whose reclamation was deferred back
+  // to the allocator on a thread of its own, so that the threads letting go of
+  // chains never have to. It reclaims whenever more than half the limit is
+  // waiting and at least once every interval, for as long as it's around;
+  // whatever is still deferred once it's gone waits for the next reclaim.
+  //
+  //   chain::deferred_reclamation<chain::chain>::set_limit(64 << 20);
+  //   chain::background_reclaimer<chain::chain> reclaimer;
+  template <class Chain>
+  class background_reclaimer;
+
+  template <class Element, class Allocator>
+  class background_reclaimer<chain_t<Element, Allocator>> {
+    typedef detail::block_reclaimer<Element, Allocator> reclaimer_type;
+
+   public:
+    explicit background_reclaimer(
+        std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100))
+    : done_(false), thread_([this, interval] {
+        while (!done_) reclaimer_type::instance().reclaim_after(interval);
+      }) {}
+
+    background_reclaimer(background_reclaimer const &) = delete;
+    background_reclaimer &operator=(background_reclaimer const &) = delete;
+
+    ~background_reclaimer() {
+      done_ = true;
+      reclaimer_type::instance().wake();
+      thread_.join();
+    }
+
+   private:
+    std::atomic<bool> done_;
+    std::thread thread_;
+  };
+
+}  // namespace chain
+
+#endif  // CHAIN_RECLAMATION_HPP
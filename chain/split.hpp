@@ -0,0 +1,185 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// split.hpp
+//
+#ifndef CHAIN_SPLIT_HPP
+#define CHAIN_SPLIT_HPP
+
+#include <cstddef>
+#include <iterator>
+
+#include <chain/chain.hpp>
+
+namespace chain {
+
+  // A split range is the fields of a chain between occurrences of a
+  // delimiter, the way lines are split on newlines or records on commas.
+  // Fields are only found as the range is walked, one at a time, and each
+  // field is a chain that refers to the blocks the chain it came from refers
+  // to, so splitting copies no elements whatever the size of the fields. We
+  // look for the delimiter a link at a time, so fields that start in one page
+  // and end in another come out whole.
+  //
+  //   for (chain::chain const &line : chain::split(log, '\n')) ...
+  //
+  // Like splitting strings usually does, a chain with n delimiters has n + 1
+  // fields, some of which may be empty; an empty chain has a single empty
+  // field, while a chain that points to nothing has none.
+  template <class Chain>
+  class split_range;
+
+  template <class Element, class Allocator>
+  class split_range<chain_t<Element, Allocator>> {
+    typedef chain_t<Element, Allocator> chain_type;
+    typedef detail::block_links<Element, Allocator> links_type;
+    typedef typename links_type::const_iterator link_iterator;
+
+   public:
+    // The iterators only ever hold the field they're at, which they make
+    // again for every step, so they're input iterators that give fields out
+    // by value: a field stays the same however far the iterator it came from
+    // goes. What operator-> points to is only good until the next step.
+    class iterator {
+     public:
+      typedef std::input_iterator_tag iterator_category;
+      typedef chain_type value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef chain_type const *pointer;
+      typedef chain_type reference;
+
+      // The end of every split range.
+      iterator()
+      : allocator_(nullptr), links_(nullptr), delimiter_(), link_(nullptr)
+      , offset_(0), last_(true), finished_(true) {}
+
+      chain_type operator*() const { return field_; }
+      pointer operator->() const { return &field_; }
+
+      iterator &operator++() {
+        next();
+        return *this;
+      }
+
+      iterator operator++(int) {
+        iterator before(*this);
+        next();
+        return before;
+      }
+
+      // Iterators are at the same field when they start looking for the next
+      // one from the same place, or when they're both past the last field.
+      bool operator==(iterator const &other) const {
+        if (finished_ || other.finished_) return finished_ == other.finished_;
+        return link_ == other.link_ && offset_ == other.offset_ &&
+               last_ == other.last_;
+      }
+
+      bool operator!=(iterator const &other) const { return !(*this == other); }
+
+     private:
+      friend class split_range;
+
+      Allocator *allocator_;
+      links_type const *links_;
+      Element delimiter_;
+      // Where the field after the current one starts.
+      link_iterator link_;
+      size_t offset_;
+      // Whether the current field is the last one, which is the case once we
+      // run out of delimiters.
+      bool last_, finished_;
+      chain_type field_;
+
+      iterator(Allocator *allocator, links_type const *links, Element delimiter)
+      : allocator_(allocator), links_(links), delimiter_(delimiter)
+      , link_(links->begin()), offset_(0), last_(false), finished_(false)
+      , field_(allocator) {
+        next();
+      }
+
+      // Makes the field that starts where the last one ended and goes up to
+      // the next delimiter or the end of the chain, moving past the delimiter.
+      void next() {
+        if (last_) {
+          finished_ = true;
+          field_ = chain_type(allocator_);
+          return;
+        }
+        links_type *field = reusable();
+        try {
+          for (;;) {
+            if (link_ == links_->end()) {
+              last_ = true;
+              break;
+            }
+            size_t found = detail::find_element(link_->data() + offset_,
+                                                link_->length - offset_, delimiter_);
+            keep(field, offset_, offset_ + found);
+            offset_ += found;
+            if (offset_ < link_->length) {
+              ++offset_;
+              break;
+            }
+            ++link_;
+            offset_ = 0;
+          }
+        } catch (...) {
+          links_type::release(field);
+          throw;
+        }
+        field_ = detail::chain_access::make(allocator_, field);
+      }
+
+      // The links of the field we're done with, if nobody kept a copy of it,
+      // so that walking the fields without keeping them doesn't make new
+      // links for each. Every field handed out is a copy, so links that only
+      // we refer to can't be seen by anyone else.
+      links_type *reusable() {
+        links_type *previous = detail::chain_access::take(field_);
+        if (previous != nullptr && previous->unique()) {
+          previous->clear();
+          return previous;
+        }
+        links_type::release(previous);
+        return links_type::make(allocator_);
+      }
+
+      void keep(links_type *field, size_t offset, size_t before) {
+        if (offset == before) return;
+        links_type::block_type::acquire(link_->target);
+        field->push_link(link_->target, link_->offset + offset, before - offset);
+      }
+    };
+
+    typedef iterator const_iterator;
+
+    split_range(chain_type const &c, Element delimiter)
+    : chain_(c), delimiter_(delimiter) {}
+
+    iterator begin() const {
+      links_type const *links = detail::chain_access::links(chain_);
+      if (links == nullptr) return iterator();
+      return iterator(detail::chain_access::allocator(chain_), links, delimiter_);
+    }
+
+    iterator end() const { return iterator(); }
+
+   private:
+    // The range holds on to the chain, so the fields can be made from its
+    // links for as long as the range is around.
+    chain_type chain_;
+    Element delimiter_;
+  };
+
+  template <class Element, class Allocator>
+  split_range<chain_t<Element, Allocator>> split(chain_t<Element, Allocator> const &c,
+                                                 Element delimiter) {
+    return split_range<chain_t<Element, Allocator>>(c, delimiter);
+  }
+
+}  // namespace chain
+
+#endif  // CHAIN_SPLIT_HPP
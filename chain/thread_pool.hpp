@@ -0,0 +1,148 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// thread_pool.hpp
+//
+#ifndef CHAIN_THREAD_POOL_HPP
+#define CHAIN_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chain {
+
+  // The parallel algorithms split their work into numbered tasks which they
+  // hand to a thread pool. Each thread in the pool starts off with a
+  // contiguous range of the tasks and, once it runs out, steals tasks from the
+  // back of the other threads' ranges. This keeps all the threads busy even
+  // when some tasks take much longer than others.
+  class thread_pool {
+   public:
+    // A pool of the given number of threads, counting the thread that calls
+    // run(...), which takes part in the work as well.
+    explicit thread_pool(unsigned threads = std::thread::hardware_concurrency())
+    : queues_(threads ? threads : 1), generation_(0), busy_(0), stopping_(false) {
+      for (unsigned i = 1; i < queues_.size(); ++i) {
+        workers_.emplace_back(&thread_pool::work, this, i);
+      }
+    }
+
+    thread_pool(thread_pool const &) = delete;
+    thread_pool &operator=(thread_pool const &) = delete;
+
+    ~thread_pool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      wake_.notify_all();
+      for (std::thread &worker : workers_) worker.join();
+    }
+
+    unsigned size() const { return static_cast<unsigned>(queues_.size()); }
+
+    // Runs task(0) through task(tasks - 1) on the threads in the pool and
+    // returns once they're all done. If any of the tasks throw, the first
+    // exception is rethrown here once the rest are done. Tasks shouldn't call
+    // run(...) on the same pool.
+    template <class Task>
+    void run(size_t tasks, Task task) {
+      if (!tasks) return;
+      std::lock_guard<std::mutex> running(run_mutex_);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = task;
+        error_ = nullptr;
+        for (size_t i = 0; i < queues_.size(); ++i) {
+          std::lock_guard<std::mutex> queue_lock(queues_[i].mutex);
+          for (size_t t = tasks * i / queues_.size();
+               t < tasks * (i + 1) / queues_.size(); ++t) {
+            queues_[i].tasks.push_back(t);
+          }
+        }
+        busy_ = queues_.size();
+        ++generation_;
+      }
+      wake_.notify_all();
+      drain(0);
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this] { return busy_ == 0; });
+      task_ = nullptr;
+      if (error_) std::rethrow_exception(error_);
+    }
+
+   private:
+    struct queue {
+      std::mutex mutex;
+      std::deque<size_t> tasks;
+    };
+
+    std::vector<queue> queues_;
+    std::vector<std::thread> workers_;
+    std::function<void(size_t)> task_;
+    std::exception_ptr error_;
+    std::mutex run_mutex_, mutex_;
+    std::condition_variable wake_, done_;
+    size_t generation_, busy_;
+    bool stopping_;
+
+    // Takes the next task from the front of our own queue, or failing that
+    // from the back of somebody else's.
+    bool next_task(size_t self, size_t &t) {
+      for (size_t i = 0; i < queues_.size(); ++i) {
+        queue &q = queues_[(self + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) continue;
+        if (i == 0) {
+          t = q.tasks.front();
+          q.tasks.pop_front();
+        } else {
+          t = q.tasks.back();
+          q.tasks.pop_back();
+        }
+        return true;
+      }
+      return false;
+    }
+
+    void drain(size_t self) {
+      size_t t;
+      while (next_task(self, t)) {
+        try {
+          task_(t);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (!error_) error_ = std::current_exception();
+        }
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!--busy_) done_.notify_all();
+    }
+
+    void work(size_t self) {
+      size_t seen = 0;
+      for (;;) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+          if (stopping_) return;
+          seen = generation_;
+        }
+        drain(self);
+      }
+    }
+  };
+
+}  // namespace chain
+
+#endif  // CHAIN_THREAD_POOL_HPP
@@ -0,0 +1,57 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// transcode.hpp
+//
+#ifndef CHAIN_TRANSCODE_HPP
+#define CHAIN_TRANSCODE_HPP
+
+#include <chain/chain.hpp>
+#include <chain/detail/utf.hpp>
+
+namespace chain {
+
+  // Transcoding converts the contents of a chain from one Unicode encoding to
+  // another. The encodings are implied by the width of the elements: u8chain
+  // (and chain) hold UTF-8, u16chain holds UTF-16 and u32chain holds UTF-32.
+  //
+  // The input is validated as it is decoded, one link at a time, and the
+  // output is written directly into the pages of a new chain that uses the
+  // output chain's allocator. Those pages are only shared with other chains
+  // when the allocator is stateless. If the input is not well-formed we return
+  // false and leave the output untouched. Transcoding a chain that points to
+  // nothing gives a chain that points to nothing.
+  template <class OutElement, class OutAllocator,
+            class InElement, class InAllocator>
+  bool transcode(chain_t<InElement, InAllocator> const &input,
+                 chain_t<OutElement, OutAllocator> &output) {
+    OutAllocator *allocator = detail::chain_access::allocator(output);
+    detail::block_links<InElement, InAllocator> const *links =
+        detail::chain_access::links(input);
+    if (links == nullptr) {
+      output = chain_t<OutElement, OutAllocator>(allocator);
+      return true;
+    }
+    detail::block_writer<OutElement, OutAllocator> writer(allocator);
+    detail::utf_encoder<OutElement, OutAllocator> encoder(writer);
+    detail::utf_decoder<sizeof(InElement)> decoder;
+    for (auto const &link : *links) {
+      InElement const *data = link.data();
+      // Pages we know to be all ASCII don't need to be decoded at all, as long
+      // as we're not in the middle of a sequence.
+      if (link.target->ascii() && decoder.finish()) {
+        encoder.widen(data, data + link.length);
+        continue;
+      }
+      if (!decoder.decode(data, data + link.length, encoder)) return false;
+    }
+    if (!decoder.finish()) return false;
+    output = detail::chain_access::make(allocator, writer.finish());
+    return true;
+  }
+
+}  // namespace chain
+
+#endif  // CHAIN_TRANSCODE_HPP
@@ -0,0 +1,198 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// versioned.hpp
+//
+#ifndef CHAIN_VERSIONED_HPP
+#define CHAIN_VERSIONED_HPP
+
+#include <algorithm>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <chain/chain.hpp>
+
+namespace chain {
+
+  // A versioned chain keeps the successive versions of a document that's
+  // edited one chain at a time. Since every version shares the blocks it has in
+  // common with the versions before it, each version only costs the blocks its
+  // edits brought in and its links, which is what we report as its
+  // incremental size. Versions are numbered from zero in the order they're
+  // committed, and any version that's still kept can be had in constant time.
+  //
+  // Versions are let go of according to the retention policy: the latest
+  // versions up to a given count are kept, along with any version that's been
+  // pinned. Letting go of a version lets go of the blocks that only it
+  // referred to.
+  //
+  //   chain::versioned_chain<chain::chain> history(100);
+  //   auto v = history.commit(document);
+  //   chain::chain then = history.at(v);
+  template <class Chain>
+  class versioned_chain;
+
+  template <class Element, class Allocator>
+  class versioned_chain<chain_t<Element, Allocator>> {
+    typedef chain_t<Element, Allocator> chain_type;
+    typedef detail::block_links<Element, Allocator> links_type;
+
+   public:
+    typedef size_t version_type;
+
+    static size_t const keep_all = static_cast<size_t>(-1);
+
+    // Keeps the latest retained versions, and every version unless told
+    // otherwise.
+    explicit versioned_chain(size_t retained = keep_all)
+    : retained_(retained), first_(0) {}
+
+    // Records the chain as the next version and returns its number.
+    version_type commit(chain_type const &c) {
+      size_t incremental = incremental_bytes(c);
+      versions_.push_back(version{c, incremental, true});
+      // Only the version that just fell behind the latest retained ones can
+      // need letting go of.
+      if (committed() > retained()) collect(committed() - retained() - 1);
+      return last();
+    }
+
+    // The version, which has to be one that's still kept.
+    chain_type const &at(version_type v) const {
+      assert(contains(v) && "The version isn't kept anymore.");
+      return versions_[v - first_].contents;
+    }
+
+    bool contains(version_type v) const {
+      return v >= first_ && v - first_ < versions_.size() &&
+             versions_[v - first_].kept;
+    }
+
+    // The number of versions committed so far, kept or not.
+    size_t committed() const { return first_ + versions_.size(); }
+
+    // The latest version, which is always kept. There has to be one.
+    version_type last() const {
+      assert(!versions_.empty() && "Nothing has been committed.");
+      return committed() - 1;
+    }
+
+    // The number of bytes the version added to the one before it when it was
+    // committed: the elements it refers to in blocks the version before it
+    // didn't refer to, plus its links.
+    size_t incremental_size(version_type v) const {
+      assert(contains(v) && "The version isn't kept anymore.");
+      return versions_[v - first_].incremental;
+    }
+
+    // Pinned versions are kept whatever the retention policy says, until
+    // they're unpinned.
+    void pin(version_type v) {
+      assert(contains(v) && "The version isn't kept anymore.");
+      pinned_.insert(v);
+    }
+
+    void unpin(version_type v) {
+      pinned_.erase(v);
+      collect(v);
+    }
+
+    // Changes how many of the latest versions are kept, letting go of the
+    // versions that aren't kept anymore. The latest version is always kept.
+    void retain(size_t retained) {
+      retained_ = retained;
+      for (version_type v = first_; v < committed(); ++v) collect(v);
+    }
+
+   private:
+    struct version {
+      chain_type contents;
+      size_t incremental;
+      bool kept;
+    };
+
+    size_t retained_;
+    // The number of the version at the front of versions_.
+    version_type first_;
+    std::deque<version> versions_;
+    std::set<version_type> pinned_;
+
+    typedef std::pair<size_t, size_t> range;
+
+    // The elements of a version that the version before it didn't refer to,
+    // plus its links. We work out which parts of which blocks the version
+    // before it refers to, merged into ranges that don't overlap, and count
+    // what the new version's links cover outside of those.
+    size_t incremental_bytes(chain_type const &c) const {
+      links_type const *links = detail::chain_access::links(c);
+      if (links == nullptr) return 0;
+      std::unordered_map<void const *, std::vector<range>> before;
+      if (!versions_.empty()) {
+        links_type const *previous =
+            detail::chain_access::links(versions_.back().contents);
+        if (previous != nullptr) {
+          for (auto const &link : *previous) {
+            before[link.target].push_back(
+                range(link.offset, size_t(link.offset) + link.length));
+          }
+        }
+      }
+      for (auto &block : before) {
+        std::vector<range> &ranges = block.second;
+        std::sort(ranges.begin(), ranges.end());
+        size_t merged = 0;
+        for (size_t i = 1; i < ranges.size(); ++i) {
+          if (ranges[i].first <= ranges[merged].second) {
+            ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
+          } else {
+            ranges[++merged] = ranges[i];
+          }
+        }
+        ranges.resize(merged + 1);
+      }
+      size_t elements = 0;
+      for (auto const &link : *links) {
+        size_t first = link.offset, last = first + link.length;
+        elements += link.length;
+        auto found = before.find(link.target);
+        if (found == before.end()) continue;
+        std::vector<range> const &ranges = found->second;
+        auto r = std::upper_bound(ranges.begin(), ranges.end(), range(first, size_t(-1)));
+        if (r != ranges.begin()) --r;
+        for (; r != ranges.end() && r->first < last; ++r) {
+          size_t from = std::max(first, r->first), to = std::min(last, r->second);
+          if (from < to) elements -= to - from;
+        }
+      }
+      return elements * sizeof(Element) + sizeof(links_type) +
+             links->link_count() * sizeof(typename links_type::link_type);
+    }
+
+    size_t retained() const { return std::max<size_t>(retained_, 1); }
+
+    // Lets go of the version if it's neither among the latest retained nor
+    // pinned, along with any versions at the front that are gone.
+    void collect(version_type v) {
+      if (contains(v) && committed() - v > retained() && !pinned_.count(v)) {
+        version &gone = versions_[v - first_];
+        gone.contents = chain_type(detail::chain_access::allocator(gone.contents));
+        gone.kept = false;
+      }
+      while (!versions_.empty() && !versions_.front().kept) {
+        versions_.pop_front();
+        ++first_;
+      }
+    }
+  };
+
+  template <class Element, class Allocator>
+  size_t const versioned_chain<chain_t<Element, Allocator>>::keep_all;
+
+}  // namespace chain
+
+#endif  // CHAIN_VERSIONED_HPP
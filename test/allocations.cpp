@@ -0,0 +1,220 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to make sure that short chains, which make up most of the chains in
+// any program, stay cheap: building one allocates its links and nothing else
+// once there's a page to put its elements in, and copying one doesn't
+// allocate at all.
+#include <chain/atomic_chain.hpp>
+#include <chain/chain.hpp>
+#include <chain/literal.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// We count everything that gets allocated from the free store, which is where
+// the standard allocator gets the pages from too, and can make a given
+// allocation fail. Arrays come from the same place, so that whatever is
+// allocated either way is given back the same way.
+static std::size_t allocations = 0, failing_allocation = 0;
+
+void *operator new(std::size_t size) {
+  if (++allocations == failing_allocation) throw std::bad_alloc();
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+// We keep the deallocation functions from being inlined, where the compiler
+// would see them free memory that came from operator new and take that for a
+// mismatch.
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void test_short_chains() {
+  using chain::chain;
+
+  // The first chain opens a page that the others then share.
+  chain first("The quick brown fox");
+  std::string contents(" jumps over the lazy dog.");
+
+  std::size_t before = allocations;
+  chain second(contents);
+  assert(allocations - before == 1);
+
+  before = allocations;
+  chain copy(second);
+  chain assigned;
+  assigned = second;
+  assert(allocations == before);
+
+  // Slicing a chain with a single link, or putting two of them together,
+  // allocates the new links and nothing else.
+  before = allocations;
+  chain sliced = second.slice(1, 5);
+  assert(allocations - before == 1);
+  before = allocations;
+  chain combined = first + second;
+  assert(allocations - before == 1);
+  assert(combined == chain("The quick brown fox jumps over the lazy dog."));
+}
+
+// A deleter that counts the buffers it disposes of.
+struct counting_deleter {
+  int *disposed;
+  void operator()(char *buffer) const {
+    ++*disposed;
+    delete[] buffer;
+  }
+};
+
+// Adopting a buffer takes it over even when making the chain fails: whichever
+// allocation fails, the buffer is disposed of exactly once.
+void test_failed_adoption() {
+  using chain::chain;
+
+  // Buffers longer than the largest block take several blocks and more links
+  // than fit in the links themselves.
+  for (std::size_t size : {std::size_t(100), std::size_t(17) << 20}) {
+    for (std::size_t fail = 1;; ++fail) {
+      int disposed = 0;
+      char *buffer = new char[size]();
+      failing_allocation = allocations + fail;
+      bool made = false;
+      try {
+        chain adopted(buffer, size, counting_deleter{&disposed});
+        failing_allocation = 0;
+        made = true;
+        assert(adopted.size() == size && disposed == 0);
+      } catch (std::bad_alloc const &) {
+        failing_allocation = 0;
+      }
+      assert(disposed == 1);
+      if (made) break;
+    }
+  }
+}
+
+// A stateless allocator that keeps track of how many pages are still around,
+// which it gets from the free store so that we can make getting one fail.
+template <class T>
+struct page_counting_allocator {
+  typedef T value_type;
+  static std::size_t outstanding;
+
+  page_counting_allocator() {}
+  template <class U>
+  page_counting_allocator(page_counting_allocator<U> const &) {}
+
+  T *allocate(std::size_t n) {
+    T *p = static_cast<T *>(::operator new(n * sizeof(T)));
+    ++outstanding;
+    return p;
+  }
+
+  void deallocate(T *p, std::size_t) {
+    --outstanding;
+    ::operator delete(p);
+  }
+
+  bool operator==(page_counting_allocator const &) const { return true; }
+  bool operator!=(page_counting_allocator const &) const { return false; }
+};
+
+template <class T>
+std::size_t page_counting_allocator<T>::outstanding = 0;
+
+// Copying contents into a chain gives back every page it took whichever
+// allocation fails, except for the last page which is kept around for the
+// next chain.
+void test_failed_copy() {
+  typedef chain::chain_t<char, page_counting_allocator<char>> counted_chain;
+  typedef std::basic_string<char, std::char_traits<char>,
+                            page_counting_allocator<char>> counted_string;
+  chain::page_pool<counted_chain>::set_watermarks(0, 0);
+  counted_string contents(5 * getpagesize(), 'x');
+  for (std::size_t fail = 1;; ++fail) {
+    failing_allocation = allocations + fail;
+    bool made = false;
+    try {
+      counted_chain copied(contents);
+      failing_allocation = 0;
+      made = true;
+      assert(copied.size() == contents.size());
+    } catch (std::bad_alloc const &) {
+      failing_allocation = 0;
+    }
+    assert(page_counting_allocator<char>::outstanding <= 2);
+    if (made) break;
+  }
+
+  // Literals copy their contents the same way.
+  chain::chain_literal literal(contents.data(), contents.size());
+  for (std::size_t fail = 1;; ++fail) {
+    failing_allocation = allocations + fail;
+    bool made = false;
+    try {
+      counted_chain copied = literal.chain<page_counting_allocator<char>>();
+      failing_allocation = 0;
+      made = true;
+      assert(copied.size() == contents.size());
+    } catch (std::bad_alloc const &) {
+      failing_allocation = 0;
+    }
+    assert(page_counting_allocator<char>::outstanding <= 2);
+    if (made) break;
+  }
+}
+
+// Storing into an atomic chain either replaces the chain or, when it can't
+// allocate what it needs to, leaves it as it was.
+void test_failed_store() {
+  using chain::atomic_chain;
+  using chain::chain;
+
+  atomic_chain<chain> routes(chain("first"));
+  chain second("second");
+  assert(routes.load() == chain("first"));
+  for (std::size_t fail = 1;; ++fail) {
+    failing_allocation = allocations + fail;
+    bool stored = false;
+    try {
+      routes.store(second);
+      failing_allocation = 0;
+      stored = true;
+    } catch (std::bad_alloc const &) {
+      failing_allocation = 0;
+      assert(routes.load() == chain("first"));
+    }
+    if (stored) break;
+  }
+  assert(routes.load() == second);
+}
+
+int main(int argc, char *argv[]) {
+  test_short_chains();
+  test_failed_adoption();
+  test_failed_copy();
+  test_failed_store();
+  return 0;
+}
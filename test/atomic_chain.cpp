@@ -0,0 +1,115 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that readers of an atomic chain always see one of the
+// chains that were stored in it, whole, while a writer keeps replacing it.
+#include <chain/atomic_chain.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+void test_single_thread() {
+  using chain::atomic_chain;
+  using chain::chain;
+
+  atomic_chain<chain> empty;
+  assert(empty.load().null());
+
+  atomic_chain<chain> routes(chain("first"));
+  chain snapshot = routes.load();
+  assert(snapshot == chain("first"));
+  chain previous = routes.exchange(chain("second"));
+  assert(previous == chain("first"));
+  assert(snapshot == chain("first"));
+  assert(routes.load() == chain("second"));
+  routes.store(chain());
+  assert(routes.load().null());
+}
+
+void test_concurrent_readers() {
+  using chain::atomic_chain;
+  using chain::chain;
+
+  // Every version has a different size, which tells the readers which one
+  // they're looking at. The writer stores fresh chains with the contents of
+  // each version so that it's the readers that let go of them last.
+  size_t const versions = 2000;
+  std::vector<std::string> contents;
+  std::vector<chain> expected;
+  for (size_t v = 0; v < versions; ++v) {
+    contents.push_back(std::string(3000 + v, char('a' + v % 26)));
+    expected.push_back(chain(contents.back()));
+  }
+
+  atomic_chain<chain> shared(expected[0]);
+  std::atomic<bool> done(false);
+  std::atomic<size_t> loads(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&] {
+      size_t seen = 0, local = 0;
+      while (!done) {
+        chain snapshot = shared.load();
+        size_t version = snapshot.size() - 3000;
+        assert(version < versions && version >= seen);
+        assert(snapshot == expected[version]);
+        seen = version;
+        ++local;
+      }
+      loads += local;
+    });
+  }
+  std::thread writer([&] {
+    for (size_t v = 1; v < versions; ++v) shared.store(chain(contents[v]));
+    done = true;
+  });
+  writer.join();
+  for (std::thread &t : readers) t.join();
+  assert(loads > 0);
+  assert(shared.load() == expected.back());
+}
+
+// A reader that stalls in the middle of a load holds back the links it named
+// and nothing else: writers carry on, and the links are let go of once the
+// reader is done with them.
+void test_stalled_reader() {
+  using chain::atomic_chain;
+  using chain::detail::hazard_domain;
+  using chain::chain;
+
+  atomic_chain<chain> shared(chain("first"));
+  chain first = shared.load();
+  void const *named = ::chain::detail::chain_access::links(first);
+  std::atomic<int> state(0);
+  std::thread reader([&] {
+    ::chain::detail::hazard_slot &hazard = ::chain::detail::thread_hazard();
+    hazard.pointer.store(named);
+    state = 1;
+    while (state != 2) std::this_thread::yield();
+    hazard.pointer.store(nullptr);
+  });
+  while (state != 1) std::this_thread::yield();
+  first = chain();
+  for (int i = 0; i < 1000; ++i) shared.store(chain("version " + std::to_string(i)));
+  assert(shared.load() == chain("version 999"));
+  hazard_domain::instance().scan();
+  assert(hazard_domain::instance().retired_size() == 1);
+  state = 2;
+  reader.join();
+  hazard_domain::instance().scan();
+  assert(hazard_domain::instance().retired_size() == 0);
+}
+
+int main(int argc, char *argv[]) {
+  test_single_thread();
+  test_concurrent_readers();
+  test_stalled_reader();
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that a hash index over a chain answers questions about its
+// slices the same way comparing the slices directly would.
+#include <chain/hash_index.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <string>
+
+// Contents with a lot of repetition so that there are plenty of long equal
+// slices in different places, spread over many pages.
+std::string sample_contents() {
+  std::string contents;
+  for (int i = 0; i < 3000; ++i) {
+    contents += "abcabcab";
+    contents += char('a' + i % 3);
+    if (i % 17 == 0) contents += "The quick brown fox.";
+  }
+  return contents;
+}
+
+void test_equal(chain::thread_pool &pool) {
+  using chain::hash_index;
+  using chain::chain;
+
+  std::string contents = sample_contents();
+  chain c(contents);
+  hash_index<char, std::allocator<char>> index(c, pool);
+  assert(index.memory_usage() == 0);
+  assert(index.size() == contents.size());
+  assert(index.memory_usage() >= (contents.size() + 1) * sizeof(uint64_t));
+
+  for (size_t a = 0; a < contents.size(); a += 97) {
+    for (size_t b = 0; b < contents.size(); b += 89) {
+      for (size_t length : {0, 1, 3, 9, 50, 4100}) {
+        if (a + length > contents.size() || b + length > contents.size()) continue;
+        bool expected = contents.compare(a, length, contents, b, length) == 0;
+        assert(index.equal(a, a + length, b, b + length) == expected);
+      }
+    }
+  }
+  // Slices of different lengths are never equal.
+  assert(!index.equal(0, 3, 3, 5));
+  assert(index.equal(0, 0, 10, 10));
+}
+
+void test_common_extension(chain::thread_pool &pool) {
+  using chain::hash_index;
+  using chain::chain;
+
+  std::string contents = sample_contents();
+  hash_index<char, std::allocator<char>> index(chain(contents), pool);
+  for (size_t a = 0; a < contents.size(); a += 131) {
+    for (size_t b = 0; b < contents.size(); b += 127) {
+      size_t expected = 0;
+      while (a + expected < contents.size() && b + expected < contents.size() &&
+             contents[a + expected] == contents[b + expected]) {
+        ++expected;
+      }
+      assert(index.common_extension(a, b) == expected);
+    }
+  }
+  assert(index.common_extension(5, 5) == contents.size() - 5);
+  assert(index.common_extension(contents.size(), 0) == 0);
+
+  // An index over an empty chain still answers the trivial questions.
+  hash_index<char, std::allocator<char>> empty(chain(""), pool);
+  assert(empty.size() == 0);
+  assert(empty.common_extension(0, 0) == 0);
+  assert(empty.equal(0, 0, 0, 0));
+}
+
+int main(int argc, char *argv[]) {
+  for (unsigned threads : {1u, 3u}) {
+    chain::thread_pool pool(threads);
+    test_equal(pool);
+    test_common_extension(pool);
+  }
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that a line index agrees with counting newlines the slow
+// way, across pages, slices and concatenations.
+#include <chain/line_index.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+typedef chain::line_index<chain::chain> index_type;
+
+// Checks every query against the contents as a string.
+void check(index_type const &index, std::string const &s) {
+  std::vector<size_t> starts(1, 0);
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '\n') starts.push_back(i + 1);
+  }
+  assert(index.line_count() == starts.size());
+  for (size_t line = 0; line < starts.size(); ++line) {
+    assert(index.line_offset(line) == starts[line]);
+    size_t end = line + 1 < starts.size() ? starts[line + 1] - 1 : s.size();
+    assert(index.line(line) == chain::chain(s.substr(starts[line], end - starts[line])));
+  }
+  size_t line = 0;
+  for (size_t offset = 0; offset <= s.size(); ++offset) {
+    assert(index.line_of(offset) == line);
+    if (offset < s.size() && s[offset] == '\n') ++line;
+  }
+}
+
+void test_small() {
+  check(index_type(chain::chain("one\ntwo\n\nfour")), "one\ntwo\n\nfour");
+  check(index_type(chain::chain("\n")), "\n");
+  check(index_type(chain::chain("no newlines")), "no newlines");
+  check(index_type(chain::chain("")), "");
+  index_type nothing((chain::chain()));
+  assert(nothing.line_count() == 0);
+}
+
+std::string log_lines(int first, int count) {
+  std::string contents;
+  for (int i = first; i < first + count; ++i) {
+    contents += "line " + std::to_string(i) + std::string(i % 50, '.') + "\n";
+  }
+  return contents;
+}
+
+// Lines that span pages are found whole, and indexes of slices and
+// concatenations agree with indexing their contents from scratch.
+void test_composition() {
+  std::string first = log_lines(0, 2000), second = log_lines(2000, 1500);
+  index_type a((chain::chain(first))), b((chain::chain(second)));
+  assert(chain::detail::chain_access::links(a.contents())->link_count() > 1);
+  check(a, first);
+  check(b, second);
+  check(a + b, first + second);
+  check(a.slice(1234, 30000), first.substr(1234, 30000));
+  check((a + b).slice(first.size() - 100, 5000), (first + second).substr(first.size() - 100, 5000));
+  check(a.slice(0, 0), "");
+  // Indexes that share a cache index chains they didn't come from too.
+  std::string joined = first + "tail";
+  check(index_type(a.contents() + chain::chain("tail"), a), joined);
+}
+
+// Slices that go further and further into a large adopted buffer scan only
+// what they add, and agree with counting the newlines the slow way.
+void test_deepening_slices() {
+  std::string contents;
+  while (contents.size() < (size_t(1) << 20)) contents += log_lines(0, 1000);
+  std::vector<char> buffer(contents.begin(), contents.end());
+  chain::chain adopted(std::move(buffer));
+  assert(chain::detail::chain_access::links(adopted)->link_count() == 1);
+  index_type first(adopted.slice(0, 10));
+  for (size_t length = 1000; length < contents.size(); length = length * 3 / 2 + 7) {
+    index_type deeper = first.slice(0, 0) + index_type(adopted.slice(0, length), first);
+    size_t newlines = std::count(contents.begin(), contents.begin() + length, '\n');
+    assert(deeper.line_count() == newlines + 1);
+    size_t offset = length / 2;
+    assert(deeper.line_of(offset) ==
+           size_t(std::count(contents.begin(), contents.begin() + offset, '\n')));
+    size_t line = newlines / 2;
+    assert(deeper.line(line) == chain::chain(contents.substr(
+                                    deeper.line_offset(line),
+                                    contents.find('\n', deeper.line_offset(line)) -
+                                        deeper.line_offset(line))));
+  }
+  check(index_type(adopted, first), contents);
+}
+
+int main(int argc, char *argv[]) {
+  test_small();
+  test_composition();
+  test_deepening_slices();
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that what we work out about literals at compile time agrees
+// with what chains with the same contents tell us at run time.
+#include <chain/literal.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <string>
+
+using namespace chain::literals;
+
+// Everything about a literal is known at compile time.
+constexpr chain::chain_literal get = "GET"_chain;
+constexpr chain::chain_literal post("POST");
+static_assert(get.size() == 3, "The length of a literal is known.");
+static_assert(post.size() == 4, "The length of a literal is known.");
+static_assert(get.hash() != post.hash(), "Different literals hash differently.");
+static_assert(""_chain.hash() == chain::chain_literal("").hash(),
+              "Literals hash the same however they're made.");
+static_assert(u"GET"_chain.hash() == U"GET"_chain.hash(),
+              "Hashes only depend on the values of the elements.");
+
+void test_comparison() {
+  using chain::chain;
+
+  chain method("GET");
+  assert(method == get && get == method);
+  assert(method != post && post != method);
+  assert(chain("GE") != get && chain("GETS") != get);
+  assert(chain("") == ""_chain && chain() != ""_chain);
+
+  // Chains spanning several links compare against literals link by link.
+  chain combined = chain("Hello, ") + chain("world!").slice(0, 5);
+  assert(combined == "Hello, world"_chain);
+  assert(combined != "Hello, World"_chain);
+  assert(get.chain() == chain("GET"));
+}
+
+void test_hash() {
+  using chain::content_hash;
+  using chain::chain_literal;
+  using chain::u32chain;
+  using chain::chain;
+
+  assert(content_hash(chain("GET")) == get.hash());
+  assert(content_hash(chain("")) == ""_chain.hash());
+  assert(content_hash(chain()) == ""_chain.hash());
+
+  // The hash only depends on the contents, not on how they're split up.
+  std::string contents;
+  for (int i = 0; i < 1000; ++i) contents += "The quick brown fox. ";
+  chain whole(contents);
+  chain pieces = whole.slice(0, 5000) + whole.slice(5000, contents.size() - 5000);
+  chain_literal literal(contents.data(), contents.size());
+  assert(content_hash(whole) == literal.hash());
+  assert(content_hash(pieces) == literal.hash());
+  assert(pieces == literal);
+  assert(content_hash(whole.slice(1, 100)) !=
+         content_hash(whole.slice(0, 100)));
+
+  u32chain wide(U"Aloha");
+  assert(content_hash(wide) == U"Aloha"_chain.hash());
+}
+
+int main(int argc, char *argv[]) {
+  test_comparison();
+  test_hash();
+  return 0;
+}
@@ -0,0 +1,64 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that a literal set built at compile time finds every one of
+// its literals, and nothing else.
+#include <chain/literal_set.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <string>
+
+using namespace chain::literals;
+
+constexpr auto headers = chain::make_literal_set(
+    "Accept"_chain, "Accept-Charset"_chain, "Accept-Encoding"_chain,
+    "Accept-Language"_chain, "Authorization"_chain, "Cache-Control"_chain,
+    "Connection"_chain, "Content-Encoding"_chain, "Content-Length"_chain,
+    "Content-Type"_chain, "Cookie"_chain, "Date"_chain, "ETag"_chain,
+    "Expect"_chain, "Expires"_chain, "From"_chain, "Host"_chain,
+    "If-Match"_chain, "If-Modified-Since"_chain, "If-None-Match"_chain,
+    "If-Range"_chain, "If-Unmodified-Since"_chain, "Last-Modified"_chain,
+    "Location"_chain, "Max-Forwards"_chain, "Origin"_chain, "Pragma"_chain,
+    "Proxy-Authorization"_chain, "Range"_chain, "Referer"_chain,
+    "Retry-After"_chain, "Server"_chain, "Set-Cookie"_chain, "TE"_chain,
+    "Trailer"_chain, "Transfer-Encoding"_chain, "Upgrade"_chain,
+    "User-Agent"_chain, "Vary"_chain, "Via"_chain, "Warning"_chain);
+
+constexpr auto single = chain::make_literal_set("GET"_chain);
+
+// The set is built at compile time, so we can ask it about literals then too.
+static_assert(headers.size() == 41, "Every literal is in the set.");
+static_assert(headers.find("Host"_chain) == 16, "Literals find themselves.");
+static_assert(headers.find("Hos"_chain) == decltype(headers)::npos,
+              "Other literals aren't in the set.");
+static_assert(single.find("GET"_chain) == 0, "Sets can have a single literal.");
+
+void test_find() {
+  using chain::chain;
+
+  for (size_t i = 0; i < headers.size(); ++i) {
+    std::string name(headers[i].data(), headers[i].size());
+    assert(headers.find(chain(name)) == i);
+    assert(headers.contains(chain(name)));
+    assert(!headers.contains(chain(name + "s")));
+    assert(!headers.contains(chain(name.substr(1))));
+  }
+  assert(!headers.contains(chain("")));
+  assert(!headers.contains(chain()));
+  assert(!headers.contains(chain("host")));
+
+  // Chains made of several links find their literals the same way.
+  chain pieces = chain("Content-") + chain("Types").slice(0, 4);
+  assert(headers.find(pieces) == 9);
+
+  assert(single.contains(chain("GET")) && !single.contains(chain("PUT")));
+}
+
+int main(int argc, char *argv[]) {
+  test_find();
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that the parallel algorithms over chains give the same
+// results as their serial counterparts no matter how many threads they use.
+#include <chain/parallel.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// We use contents that span many pages so that the work gets split into many
+// tasks, some of which are bigger than others.
+std::string sample_contents() {
+  std::string contents;
+  for (int i = 0; i < 20000; ++i) {
+    contents += "The quick brown fox jumps over the lazy dog. ";
+    if (i % 7 == 0) contents += std::string(i % 300, 'z');
+  }
+  return contents;
+}
+
+void test_count(chain::thread_pool &pool) {
+  using chain::parallel_count;
+  using chain::chain;
+
+  std::string contents = sample_contents();
+  chain c(contents);
+  assert(parallel_count(c, 'o', pool) ==
+         size_t(std::count(contents.begin(), contents.end(), 'o')));
+  assert(parallel_count(c, '#', pool) == 0);
+  assert(parallel_count(chain(), 'o', pool) == 0);
+  assert(parallel_count(chain(""), 'o', pool) == 0);
+}
+
+void test_find(chain::thread_pool &pool) {
+  using chain::parallel_find;
+  using chain::npos;
+  using chain::chain;
+
+  std::string contents = sample_contents();
+  chain c(contents);
+  assert(parallel_find(c, 'q', pool) == contents.find('q'));
+  assert(parallel_find(c, '#', pool) == npos);
+  assert(parallel_find(chain(), 'q', pool) == npos);
+
+  // Something only found near the end shouldn't be beaten by anything else.
+  contents[contents.size() - 10] = '#';
+  contents[contents.size() - 3] = '#';
+  assert(parallel_find(chain(contents), '#', pool) == contents.size() - 10);
+}
+
+void test_transform(chain::thread_pool &pool) {
+  using chain::parallel_transform;
+  using chain::chain;
+
+  std::string contents = sample_contents();
+  std::string upper(contents);
+  std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+  chain transformed = parallel_transform(
+      chain(contents), [](char c) { return char(::toupper(c)); }, pool);
+  assert(transformed == chain(upper));
+
+  // Transforming a chain that points to nothing gives a chain that points to
+  // nothing, while empty chains stay empty.
+  chain defaulted, empty("");
+  auto identity = [](char c) { return c; };
+  assert(parallel_transform(defaulted, identity, pool) == defaulted);
+  assert(parallel_transform(empty, identity, pool) == empty);
+}
+
+void test_reduce(chain::thread_pool &pool) {
+  using chain::parallel_reduce;
+  using chain::u32chain;
+  using chain::chain;
+
+  std::string contents = sample_contents();
+  auto plus = [](unsigned long long l, unsigned long long r) { return l + r; };
+  assert(parallel_reduce(chain(contents), 42ull, plus, pool) ==
+         std::accumulate(contents.begin(), contents.end(), 42ull));
+  assert(parallel_reduce(chain(), 42ull, plus, pool) == 42ull);
+
+  // The reduction doesn't have to be commutative, only associative, which we
+  // check by putting the elements back together in order.
+  struct text {
+    std::u32string s;
+    text(char32_t c) : s(1, c) {}
+    explicit text(std::u32string s) : s(s) {}
+  };
+  auto concatenate = [](text const &l, text const &r) { return text(l.s + r.s); };
+  std::u32string alphabet = U"abcdefghijklmnopqrstuvwxyz";
+  std::u32string repeated;
+  for (int i = 0; i < 1000; ++i) repeated += alphabet;
+  assert(parallel_reduce(u32chain(repeated), text(U">"), concatenate, pool).s ==
+         U">" + repeated);
+}
+
+// An adopted buffer is a single link however long it is, which still gets
+// cut into as many tasks as there would be for the same contents in pages.
+void test_long_links(chain::thread_pool &pool) {
+  using chain::parallel_count;
+  using chain::parallel_find;
+  using chain::parallel_transform;
+  using chain::chain;
+
+  std::string contents;
+  while (contents.size() < (size_t(4) << 20)) contents += sample_contents();
+  std::vector<char> buffer(contents.begin(), contents.end());
+  chain adopted(std::move(buffer));
+  auto const *links = ::chain::detail::chain_access::links(adopted);
+  assert(links->link_count() == 1);
+  ::chain::detail::partition<char> parts(links, pool.size());
+  assert(parts.task_count() >= 8 * pool.size());
+  assert(parts.total == contents.size());
+  assert(parallel_count(adopted, 'z', pool) ==
+         size_t(std::count(contents.begin(), contents.end(), 'z')));
+  assert(parallel_find(adopted, 'T', pool) == 0);
+  assert(parallel_find(adopted + chain("#"), '#', pool) == contents.size());
+  std::string upper(contents);
+  std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+  assert(parallel_transform(adopted, [](char c) { return char(::toupper(c)); },
+                            pool) == chain(upper));
+}
+
+int main(int argc, char *argv[]) {
+  for (unsigned threads : {1u, 2u, 4u}) {
+    chain::thread_pool pool(threads);
+    test_count(pool);
+    test_find(pool);
+    test_transform(pool);
+    test_reduce(pool);
+    test_long_links(pool);
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that chains on memory resources get everything they need
+// from their resource, and nothing from anywhere else.
+#include <chain/pmr.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// We count what gets allocated from the free store so that we can tell that
+// the chains didn't allocate anything there.
+static std::size_t free_store_allocations = 0;
+
+void *operator new(std::size_t size) {
+  ++free_store_allocations;
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+// A resource that keeps track of how much of it is in use.
+struct counting_resource : std::pmr::memory_resource {
+  std::size_t allocations = 0, outstanding = 0;
+
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations;
+    outstanding += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+    outstanding -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+void test_everything_from_the_resource() {
+  using chain::pmr::chain;
+
+  counting_resource resource;
+  std::pmr::polymorphic_allocator<char> allocator(&resource);
+  std::pmr::string contents(&resource);
+  for (int i = 0; i < 1000; ++i) contents += "The quick brown fox. ";
+  {
+    std::size_t before = free_store_allocations;
+    chain c(contents, &allocator);
+    chain sliced = c.slice(100, 5000);
+    chain combined = sliced + c + chain(contents, &allocator);
+    assert(free_store_allocations == before);
+    assert(combined.slice(0, 5000) == sliced);
+    assert(combined.slice(5000, contents.size()) == c);
+  }
+  // Once the chains are gone the resource has everything back.
+  contents.clear();
+  contents.shrink_to_fit();
+  assert(resource.outstanding == 0);
+}
+
+void test_arenas() {
+  using chain::pmr::chain;
+
+  // Chains in one arena don't hold on to anything in another, so the arenas
+  // can go away in any order once their chains are gone.
+  auto *first = new std::pmr::monotonic_buffer_resource();
+  std::pmr::polymorphic_allocator<char> first_allocator(first);
+  std::pmr::monotonic_buffer_resource second;
+  std::pmr::polymorphic_allocator<char> second_allocator(&second);
+  {
+    chain a(std::pmr::string("Hello, ", first), &first_allocator);
+    chain b(std::pmr::string("world!", first), &first_allocator);
+    assert(a + b == chain(std::pmr::string("Hello, world!", first), &first_allocator));
+  }
+  delete first;
+  chain c(std::pmr::string("Still here.", &second), &second_allocator);
+  chain d(std::pmr::string("Still here.", &second), &second_allocator);
+  assert(c == d);
+
+  // Contents too big for a single block of an arena go into several.
+  std::pmr::string big(&second);
+  for (int i = 0; i < 1000000; ++i) big += "0123456789";
+  chain e(big, &second_allocator);
+  assert(e == chain(big, &second_allocator));
+  assert(e.slice(8388600, 20) == chain(big.substr(8388600, 20), &second_allocator));
+}
+
+void test_swap() {
+  using chain::pmr::chain;
+
+  counting_resource first, second;
+  std::pmr::polymorphic_allocator<char> first_allocator(&first),
+      other_first_allocator(&first), second_allocator(&second);
+  chain a(std::pmr::string("The quick brown fox.", &first), &first_allocator);
+  chain b(std::pmr::string("jumps over", &first), &other_first_allocator);
+  chain c(std::pmr::string("the lazy dog.", &second), &second_allocator);
+
+  // Allocators on the same resource compare equal so swapping doesn't
+  // allocate anything.
+  std::size_t allocations = first.allocations;
+  assert(a.swap(b));
+  assert(first.allocations == allocations);
+  assert(a == chain("jumps over"));
+  assert(b == chain("The quick brown fox."));
+
+  // Chains on different resources copy into each other's resources.
+  assert(a.swap(c));
+  assert(a == chain("the lazy dog."));
+  assert(c == chain("jumps over"));
+  a = chain(&first_allocator);
+  b = chain(&first_allocator);
+  assert(first.outstanding == 0);
+}
+
+int main(int argc, char *argv[]) {
+  test_everything_from_the_resource();
+  test_arenas();
+  test_swap();
+  return 0;
+}
@@ -0,0 +1,127 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that pages whose reclamation is deferred only go back to
+// the allocator when they're reclaimed, and that there are never more of them
+// waiting than the limit allows.
+#include <chain/reclamation.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+// A stateless allocator that counts what it gives back.
+template <class T>
+struct counting_allocator : std::allocator<T> {
+  static size_t deallocations;
+
+  template <class U>
+  struct rebind {
+    typedef counting_allocator<U> other;
+  };
+
+  counting_allocator() {}
+  template <class U>
+  counting_allocator(counting_allocator<U> const &) {}
+
+  void deallocate(T *p, size_t n) {
+    ++deallocations;
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+template <class T>
+size_t counting_allocator<T>::deallocations = 0;
+
+typedef chain::chain_t<char, counting_allocator<char>> counted_chain;
+typedef chain::deferred_reclamation<counted_chain> reclamation;
+typedef std::basic_string<char, std::char_traits<char>, counting_allocator<char>>
+    counted_string;
+
+counted_string pages(size_t n) { return counted_string(n * getpagesize(), 'x'); }
+
+void test_reclaim() {
+  // A chain spanning ten pages gives nine of them back when it goes away;
+  // the last one is still being filled.
+  reclamation::set_limit(size_t(1) << 20);
+  counted_string ten = pages(10), three = pages(3);
+  size_t before = counting_allocator<char>::deallocations;
+  { counted_chain c(ten); }
+  assert(counting_allocator<char>::deallocations == before);
+  assert(reclamation::size() >= 9 * size_t(getpagesize()));
+  reclamation::reclaim();
+  assert(reclamation::size() == 0);
+  assert(counting_allocator<char>::deallocations >= before + 9);
+
+  // Going over the limit reclaims everything that was waiting.
+  size_t limit = 8 * (getpagesize() + 128);
+  reclamation::set_limit(limit);
+  for (int i = 0; i < 5; ++i) {
+    { counted_chain c(three); }
+    assert(reclamation::size() <= limit);
+  }
+
+  // Turning deferred reclamation off gives back everything that was waiting,
+  // and pages go straight back from then on.
+  reclamation::set_limit(0);
+  assert(reclamation::size() == 0);
+  before = counting_allocator<char>::deallocations;
+  { counted_chain c(three); }
+  assert(reclamation::size() == 0);
+  assert(counting_allocator<char>::deallocations > before);
+}
+
+// Pages that the pool lets go of when it goes over its high watermark are
+// deferred too, rather than given back on the thread that released them.
+void test_pool_overflow() {
+  chain::page_pool<counted_chain>::set_watermarks(64, 256);
+  reclamation::set_limit(size_t(1) << 30);
+  counted_string many = pages(300);
+  size_t before = counting_allocator<char>::deallocations;
+  { counted_chain c(many); }
+  assert(counting_allocator<char>::deallocations == before);
+  assert(reclamation::size() >= 192 * size_t(getpagesize()));
+  // Trimming the pool defers what it lets go of the same way.
+  size_t deferred = reclamation::size();
+  chain::page_pool<counted_chain>::trim();
+  assert(counting_allocator<char>::deallocations == before);
+  assert(reclamation::size() > deferred);
+  reclamation::reclaim();
+  assert(reclamation::size() == 0);
+  assert(counting_allocator<char>::deallocations >= before + 299);
+  reclamation::set_limit(0);
+  chain::page_pool<counted_chain>::set_watermarks(0, 0);
+}
+
+void test_background() {
+  reclamation::set_limit(size_t(1) << 30);
+  {
+    chain::background_reclaimer<counted_chain> reclaimer(
+        std::chrono::milliseconds(1));
+    { counted_chain c(pages(10)); }
+    for (int i = 0; i < 5000 && reclamation::size() != 0; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert(reclamation::size() == 0);
+  }
+  // Once the background reclaimer is gone pages wait for the next reclaim.
+  { counted_chain c(pages(10)); }
+  assert(reclamation::size() != 0);
+  reclamation::set_limit(0);
+}
+
+int main(int argc, char *argv[]) {
+  // Pages that go into the pool aren't given back at all, so we turn it off.
+  chain::page_pool<counted_chain>::set_watermarks(0, 0);
+  test_reclaim();
+  test_background();
+  test_pool_overflow();
+  return 0;
+}
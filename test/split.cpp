@@ -0,0 +1,137 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that splitting a chain gives the same fields splitting the
+// same contents as a string would, without copying any of them.
+#include <chain/split.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// The fields of a string the way splitting chains should find them.
+std::vector<std::string> fields_of(std::string const &s, char delimiter) {
+  std::vector<std::string> fields;
+  size_t start = 0;
+  for (size_t found = s.find(delimiter); found != std::string::npos;
+       found = s.find(delimiter, start)) {
+    fields.push_back(s.substr(start, found - start));
+    start = found + 1;
+  }
+  fields.push_back(s.substr(start));
+  return fields;
+}
+
+std::vector<chain::chain> split_fields(chain::chain const &c, char delimiter) {
+  std::vector<chain::chain> fields;
+  for (chain::chain const &field : chain::split(c, delimiter)) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+void check(std::string const &s, char delimiter) {
+  std::vector<std::string> expected = fields_of(s, delimiter);
+  std::vector<chain::chain> fields = split_fields(chain::chain(s), delimiter);
+  assert(fields.size() == expected.size());
+  for (size_t i = 0; i < fields.size(); ++i) {
+    assert(fields[i] == chain::chain(expected[i]));
+  }
+}
+
+void test_fields() {
+  check("a,b,c", ',');
+  check("a,,b", ',');
+  check(",a,", ',');
+  check(",", ',');
+  check("", ',');
+  check("no delimiters here", ',');
+  assert(split_fields(chain::chain(), ',').empty());
+
+  // The range can be walked more than once, and iterators can be compared.
+  chain::chain line("GET /index.html HTTP/1.1");
+  auto words = chain::split(line, ' ');
+  size_t count = 0;
+  for (auto i = words.begin(); i != words.end(); ++i) ++count;
+  assert(count == 3);
+  auto first = words.begin(), second = words.begin();
+  assert(first == second && first != words.end());
+  assert(*second++ == chain::chain("GET"));
+  assert(first != second && *second == chain::chain("/index.html"));
+  assert(words.begin()->size() == 3);
+
+  // Fields are handed out by value, so a field that's kept doesn't change as
+  // the iterator it came from moves on.
+  typedef chain::split_range<chain::chain>::iterator split_iterator;
+  static_assert(std::is_same<std::iterator_traits<split_iterator>::iterator_category,
+                             std::input_iterator_tag>::value,
+                "Split iterators only hold the field they're at.");
+  auto walking = words.begin();
+  chain::chain kept = *walking;
+  ++walking;
+  ++walking;
+  assert(kept == chain::chain("GET") && *walking == chain::chain("HTTP/1.1"));
+
+  // Default and end iterators can be copied and compared like any other.
+  chain::split_range<chain::chain>::iterator defaulted, copied(defaulted);
+  auto end = words.end(), end_copy = end;
+  assert(copied == defaulted && end_copy == end && copied == end);
+}
+
+// Fields that span pages come out whole, and refer to the same pages as the
+// chain they came from instead of copies of them.
+void test_across_pages() {
+  std::string contents;
+  for (int i = 0; i < 5000; ++i) {
+    contents += "line " + std::to_string(i) + " of the log\n";
+  }
+  chain::chain log(contents);
+  check(contents, '\n');
+  auto const *links = chain::detail::chain_access::links(log);
+  assert(links->link_count() > 1);
+  size_t lines = 0;
+  for (chain::chain const &line : chain::split(log, '\n')) {
+    for (auto const &field_link : *chain::detail::chain_access::links(line)) {
+      bool shared = false;
+      for (auto const &link : *links) {
+        shared = shared || link.target == field_link.target;
+      }
+      assert(shared);
+    }
+    ++lines;
+  }
+  assert(lines == 5001);
+
+  // Fields that start in one chain and end in another are found too.
+  chain::chain joined = chain::chain("a,b") + chain::chain("c,d") + chain::chain(",");
+  std::vector<chain::chain> fields = split_fields(joined, ',');
+  assert(fields.size() == 4);
+  assert(fields[1] == chain::chain("bc") && fields[2] == chain::chain("d") &&
+         fields[3] == chain::chain(""));
+}
+
+// Wider elements are split the same way.
+void test_wide() {
+  std::u32string contents;
+  for (int i = 0; i < 100; ++i) contents += U"fieldé,";
+  std::vector<chain::u32chain> fields;
+  for (chain::u32chain const &field : chain::split(chain::u32chain(contents), U',')) {
+    fields.push_back(field);
+  }
+  assert(fields.size() == 101);
+  assert(fields[42] == chain::u32chain(std::u32string(U"fieldé")));
+  assert(fields[100].empty());
+}
+
+int main(int argc, char *argv[]) {
+  test_fields();
+  test_across_pages();
+  test_wide();
+  return 0;
+}
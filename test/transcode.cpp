@@ -0,0 +1,222 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test transcoding chains between the Unicode encodings implied by
+// their element types.
+#include <chain/transcode.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <set>
+#include <string>
+
+// Scoped allocators know which of them are still around, so that we can tell
+// when anything is allocated or deallocated through one that's already gone.
+template <class T>
+struct scoped_allocator {
+  typedef T value_type;
+  int tag;
+
+  static std::set<void const *> &live() {
+    static std::set<void const *> instances;
+    return instances;
+  }
+
+  scoped_allocator() : tag(0) { live().insert(this); }
+  explicit scoped_allocator(int tag) : tag(tag) { live().insert(this); }
+  scoped_allocator(scoped_allocator const &other) : tag(other.tag) {
+    live().insert(this);
+  }
+  template <class U>
+  scoped_allocator(scoped_allocator<U> const &other) : tag(other.tag) {
+    live().insert(this);
+  }
+  ~scoped_allocator() { live().erase(this); }
+
+  T *allocate(std::size_t n) {
+    assert(live().count(this) && "Allocating through a dead allocator.");
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    assert(live().count(this) && "Deallocating through a dead allocator.");
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  bool operator==(scoped_allocator const &other) const { return tag == other.tag; }
+  bool operator!=(scoped_allocator const &other) const { return tag != other.tag; }
+};
+
+// The most common case is transcoding from UTF-8, which is what we usually get
+// from the outside world, to UTF-16 or UTF-32.
+void test_from_utf8() {
+  using chain::u16chain;
+  using chain::u32chain;
+  using chain::u8chain;
+  using chain::transcode;
+  using chain::chain;
+
+  // ASCII is the same in every encoding.
+  chain ascii("The quick brown fox jumps over the lazy dog.");
+  u16chain ascii_16;
+  assert(transcode(ascii, ascii_16));
+  assert(ascii_16 == u16chain(u"The quick brown fox jumps over the lazy dog."));
+
+  // Then we have two, three and four byte sequences.
+  chain mixed("caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80!");
+  u16chain mixed_16;
+  assert(transcode(mixed, mixed_16));
+  assert(mixed_16 == u16chain(u"café € \U0001F600!"));
+  u32chain mixed_32;
+  assert(transcode(mixed, mixed_32));
+  assert(mixed_32 == u32chain(U"café € \U0001F600!"));
+
+  // Unsigned 8-bit chains are UTF-8 too.
+  typedef std::basic_string<unsigned char> u8string;
+  unsigned char euro[] = "\xe2\x82\xac";
+  u8chain euro_8{u8string(euro)};
+  u16chain euro_16;
+  assert(transcode(euro_8, euro_16));
+  assert(euro_16 == u16chain(u"€"));
+
+  // Chains that point to nothing transcode to chains that point to nothing,
+  // while empty chains give empty chains.
+  u16chain defaulted, empty(u"");
+  u16chain output(u"not yet");
+  assert(transcode(chain(), output));
+  assert(output == defaulted);
+  assert(transcode(chain(""), output));
+  assert(output == empty);
+}
+
+// We want to get back what we started with when going the other way.
+void test_round_trip() {
+  using chain::u16chain;
+  using chain::u32chain;
+  using chain::transcode;
+  using chain::chain;
+
+  chain original("na\xc3\xafve r\xc3\xa9sum\xc3\xa9 \xf0\x9f\x98\x80");
+  u16chain utf_16;
+  u32chain utf_32;
+  chain from_16, from_32;
+  assert(transcode(original, utf_16));
+  assert(transcode(utf_16, utf_32));
+  assert(transcode(utf_16, from_16));
+  assert(transcode(utf_32, from_32));
+  assert(from_16 == original);
+  assert(from_32 == original);
+}
+
+// Chains that are longer than a page span several blocks, which means that
+// multi-byte sequences end up split between links.
+void test_split_sequences() {
+  using chain::u16chain;
+  using chain::transcode;
+  using chain::chain;
+
+  std::string utf_8;
+  std::u16string utf_16;
+  for (int i = 0; i < 5000; ++i) {
+    utf_8 += "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+    utf_16 += u"aé€\U0001F600";
+  }
+  chain long_8(utf_8);
+  u16chain long_16;
+  assert(transcode(long_8, long_16));
+  assert(long_16 == u16chain(utf_16));
+
+  chain back;
+  assert(transcode(long_16, back));
+  assert(back == long_8);
+}
+
+// Chains that were validated on construction remember which of their pages are
+// all ASCII, which transcoding can take advantage of.
+void test_validated_input() {
+  using chain::u32chain;
+  using chain::transcode;
+  using chain::validate_utf8;
+  using chain::chain;
+
+  std::string ascii;
+  std::u32string ascii_32;
+  for (int i = 0; i < 1000; ++i) {
+    ascii += "The quick brown fox. ";
+    ascii_32 += U"The quick brown fox. ";
+  }
+  u32chain output;
+  assert(transcode(chain(ascii, validate_utf8), output));
+  assert(output == u32chain(ascii_32));
+
+  std::string mixed = ascii + "\xc3\xa9" + ascii;
+  std::u32string mixed_32 = ascii_32 + U"é" + ascii_32;
+  assert(transcode(chain(mixed, validate_utf8), output));
+  assert(output == u32chain(mixed_32));
+}
+
+// Malformed input is rejected and leaves the output alone.
+void test_validation() {
+  using chain::u16chain;
+  using chain::u32chain;
+  using chain::transcode;
+  using chain::chain;
+
+  u16chain output(u"untouched");
+  u16chain untouched(u"untouched");
+  assert(!transcode(chain("\xc0\x80"), output));          // Overlong.
+  assert(!transcode(chain("\xe0\x80\xaf"), output));      // Overlong.
+  assert(!transcode(chain("\xed\xa0\x80"), output));      // Surrogate.
+  assert(!transcode(chain("\xf4\x90\x80\x80"), output));  // Beyond U+10FFFF.
+  assert(!transcode(chain("\xe2\x82"), output));          // Truncated.
+  assert(!transcode(chain("\x80"), output));              // Stray continuation.
+  assert(!transcode(chain("\xff"), output));              // Invalid byte.
+  assert(output == untouched);
+
+  char16_t lone_high[] = {0xD800, u'a', 0};
+  char16_t lone_low[] = {0xDC00, 0};
+  chain utf_8;
+  assert(!transcode(u16chain(lone_high), utf_8));
+  assert(!transcode(u16chain(lone_low), utf_8));
+
+  char32_t too_large[] = {0x110000, 0};
+  char32_t surrogate[] = {0xDFFF, 0};
+  assert(!transcode(u32chain(too_large), output));
+  assert(!transcode(u32chain(surrogate), output));
+  assert(output == untouched);
+}
+
+// Transcoding into a chain with a stateful allocator writes into pages of its
+// own, so the output doesn't leave a page behind that has to be given back
+// through the allocator once it's gone.
+void test_stateful_output() {
+  using chain::transcode;
+  typedef chain::chain_t<char16_t, scoped_allocator<char16_t>> scoped_u16chain;
+  typedef std::basic_string<char16_t, std::char_traits<char16_t>,
+                            scoped_allocator<char16_t>> scoped_u16string;
+  chain::chain input("caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80!");
+  scoped_u16string expected(u"café € \U0001F600!");
+  {
+    scoped_allocator<char16_t> first(1);
+    scoped_u16chain output(&first);
+    assert(transcode(input, output));
+    assert(output == scoped_u16chain(expected, &first));
+  }
+  scoped_allocator<char16_t> second(2);
+  scoped_u16chain output(&second);
+  assert(transcode(input, output));
+  assert(output == scoped_u16chain(expected, &second));
+}
+
+int main(int argc, char *argv[]) {
+  test_from_utf8();
+  test_round_trip();
+  test_split_sequences();
+  test_validated_input();
+  test_validation();
+  test_stateful_output();
+  return 0;
+}
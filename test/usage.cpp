@@ -5,7 +5,9 @@
 // http://www.boost.org/LICENSE_1_0.txt)
 
 // We want to test the semantics of the chain implementation so we include the
-// most top-level header that wires the basics of chains up.
+// most top-level header that wires the basics of chains up. We also want to
+// see how often the reference counts of the links change.
+#define CHAIN_COUNT_REFERENCES
 #include <chain/chain.hpp>
 
 // We also want to be able to assert that our assumptions and understanding is
@@ -16,12 +18,116 @@
 // implementation of swap.
 #include <utility>
 
+// We also want to sort chains and use them as keys.
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 // In the context of this test we would like to define an allocator
 // implementation that we can use in the tests for usage.
 template <class T>
 struct test_allocator {
-  // TODO(dberris): Implement this to conform to the Allocator concept
-  // requirements.
+  // We just defer to the standard allocator for the actual memory but still
+  // conform to the Allocator concept requirements.
+  typedef T value_type;
+
+  T *allocate(std::size_t n) {
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  bool operator==(test_allocator const &) const { return true; }
+  bool operator!=(test_allocator const &) const { return false; }
+};
+
+// We also want a stateful allocator whose instances don't all compare equal,
+// so that chains using different instances have to copy their contents when
+// they're swapped. It counts the allocations it makes so that we can tell how
+// much copying had to allocate.
+template <class T>
+struct tagged_allocator {
+  typedef T value_type;
+  int tag;
+  static std::size_t allocations;
+
+  tagged_allocator() : tag(0) {}
+  explicit tagged_allocator(int tag) : tag(tag) {}
+  template <class U>
+  tagged_allocator(tagged_allocator<U> const &other) : tag(other.tag) {}
+
+  T *allocate(std::size_t n) {
+    ++allocations;
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  bool operator==(tagged_allocator const &other) const { return tag == other.tag; }
+  bool operator!=(tagged_allocator const &other) const { return tag != other.tag; }
+};
+
+template <class T>
+std::size_t tagged_allocator<T>::allocations = 0;
+
+// Pooled allocators are tagged allocators too, but they all draw from the same
+// upstream memory which outlives them, so chains using any of them can take
+// over each other's blocks.
+template <class T>
+struct pooled_allocator : tagged_allocator<T> {
+  pooled_allocator() {}
+  explicit pooled_allocator(int tag) : tagged_allocator<T>(tag) {}
+  template <class U>
+  pooled_allocator(pooled_allocator<U> const &other) : tagged_allocator<T>(other) {}
+};
+
+namespace chain {
+  template <class T>
+  struct allocator_adoption<pooled_allocator<T>> {
+    static bool can_adopt(pooled_allocator<T> const &, pooled_allocator<T> const &) {
+      return true;
+    }
+  };
+}  // namespace chain
+
+// Scoped allocators are tagged allocators that know which of them are still
+// around, so that we can tell when anything is allocated or deallocated
+// through one that's already gone.
+template <class T>
+struct scoped_allocator : tagged_allocator<T> {
+  static std::set<void const *> &live() {
+    static std::set<void const *> instances;
+    return instances;
+  }
+
+  scoped_allocator() { live().insert(this); }
+  explicit scoped_allocator(int tag) : tagged_allocator<T>(tag) {
+    live().insert(this);
+  }
+  scoped_allocator(scoped_allocator const &other) : tagged_allocator<T>(other) {
+    live().insert(this);
+  }
+  template <class U>
+  scoped_allocator(scoped_allocator<U> const &other) : tagged_allocator<T>(other) {
+    live().insert(this);
+  }
+  ~scoped_allocator() { live().erase(this); }
+
+  T *allocate(std::size_t n) {
+    assert(live().count(this) && "Allocating through a dead allocator.");
+    return tagged_allocator<T>::allocate(n);
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    assert(live().count(this) && "Deallocating through a dead allocator.");
+    tagged_allocator<T>::deallocate(p, n);
+  }
 };
 
 // For the most part we would like to be able to construct a chain. The
@@ -77,6 +183,39 @@ void test_construction() {
   }
 }
 
+// Chains of 8-bit elements can also check that their contents are well-formed
+// UTF-8 as they're being constructed.
+void test_validated_construction() {
+  using chain::u8chain;
+  using chain::validate_utf8;
+  using chain::chain;
+
+  // Well-formed contents give the same chain as the unchecked construction.
+  chain valid("caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80", validate_utf8);
+  assert(valid == chain("caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80"));
+  chain empty("", validate_utf8);
+  assert(empty == chain(""));
+
+  // Malformed contents give a chain that points to nothing.
+  chain defaulted;
+  assert(chain("\xc0\xaf", validate_utf8) == defaulted);
+  assert(chain("\xed\xa0\x80", validate_utf8) == defaulted);
+  assert(chain(std::string("abc\xe2\x82"), validate_utf8) == defaulted);
+
+  // Contents that span several pages have sequences split between them, which
+  // we should be able to tell apart from malformed ones.
+  std::string long_contents;
+  for (int i = 0; i < 5000; ++i) long_contents += "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+  assert(chain(long_contents, validate_utf8) == chain(long_contents));
+  long_contents[long_contents.size() / 2] = '\x80';
+  assert(chain(long_contents, validate_utf8) == defaulted);
+
+  typedef std::basic_string<unsigned char> u8string;
+  unsigned char quick_brown[] = "The quick brown fox!!!";
+  assert(u8chain(u8string(quick_brown), validate_utf8) ==
+         u8chain(u8string(quick_brown)));
+}
+
 // Not only don't we want chains to be constructible, we also want them to be
 // copy constructible. This is important because we intend to provide full value
 // semantics.
@@ -158,6 +297,356 @@ void test_swap() {
   assert(a == b);
   assert(a == defaulted);
   assert(b == defaulted);
+
+  // Chains whose allocators don't compare equal swap by copying their
+  // contents into each other's allocators. We try both small and large
+  // contents since large copies take a different path.
+  typedef ::chain::chain_t<char, tagged_allocator<char>> tagged_chain;
+  typedef std::basic_string<char, std::char_traits<char>, tagged_allocator<char>>
+      tagged_string;
+  tagged_allocator<char> other_allocator(1);
+  tagged_string large;
+  for (int i = 0; i < 1700000; ++i) large += "0123456789";
+  tagged_chain small_chain("The quick brown fox."), large_chain(large);
+  tagged_chain other(&other_allocator);
+  assert(other.swap(large_chain));
+  assert(other == tagged_chain(large));
+  assert(large_chain == tagged_chain());
+  // Each side's copy takes a single allocation of just the right size for
+  // every 8 MB of its contents, or part thereof.
+  std::size_t allocations = tagged_allocator<char>::allocations;
+  std::size_t const reservation = std::size_t(8) << 20;
+  assert(other.swap(small_chain));
+  assert(tagged_allocator<char>::allocations - allocations ==
+         1 + (large.size() + reservation - 1) / reservation);
+  assert(other == tagged_chain("The quick brown fox."));
+  assert(small_chain == tagged_chain(large));
+
+  // Chains whose allocators can adopt each other's blocks swap without
+  // copying anything, even though their allocators don't compare equal.
+  typedef ::chain::chain_t<char, pooled_allocator<char>> pooled_chain;
+  pooled_allocator<char> first_pool(1), second_pool(2);
+  pooled_chain first(&first_pool), second(&second_pool);
+  pooled_chain("The quick brown fox.").swap(first);
+  pooled_chain("jumps over the lazy dog.").swap(second);
+  allocations = tagged_allocator<char>::allocations;
+  assert(first.swap(second));
+  assert(tagged_allocator<char>::allocations == allocations);
+  assert(first == pooled_chain("jumps over the lazy dog."));
+  assert(second == pooled_chain("The quick brown fox."));
+}
+
+// Chains are ordered the same way the strings they were constructed from are,
+// which lets us sort them and use them as keys in ordered containers.
+void test_ordering() {
+  using chain::u16chain;
+  using chain::chain;
+
+  chain apple("apple"), apples("apples"), banana("banana"), empty(""), defaulted;
+  assert(apple < apples && apples < banana && apple < banana);
+  assert(!(apples < apple) && apples > apple && banana >= apples);
+  assert(apple <= apple && apple >= apple && !(apple < apple));
+  assert(apple.compare(chain("apple")) == 0);
+
+  // Chains that point to nothing come before empty chains, which come before
+  // everything else.
+  assert(defaulted < empty && empty < apple);
+  assert(defaulted.compare(chain()) == 0);
+
+  // Elements compare as unsigned values, like they do in std::string.
+  assert(chain("z") < chain("\xc3\xa9"));
+  assert(std::string("z") < std::string("\xc3\xa9"));
+  char16_t high[] = {0xFF00, 0};
+  assert(u16chain(u"z") < u16chain(high));
+
+  // The difference might only show up in the middle of a later page, after
+  // long stretches of identical contents in links that don't line up.
+  std::string left(20000, 'x'), right(20000, 'x');
+  right[15000] = 'y';
+  assert(chain(left) < chain(right));
+  assert(chain(right) > chain(left));
+  assert(chain(left) == chain(left));
+
+  // Finally we can sort and key ordered containers with chains.
+  std::vector<chain> fruits = {banana, apples, apple, empty};
+  std::sort(fruits.begin(), fruits.end());
+  assert(fruits[0] == empty && fruits[1] == apple && fruits[2] == apples &&
+         fruits[3] == banana);
+  std::map<chain, int> prices;
+  prices[banana] = 3;
+  prices[apple] = 1;
+  prices[chain("apple")] = 2;
+  assert(prices.size() == 2 && prices[apple] == 2);
+}
+
+// Slicing and concatenating chains gives new chains that share the blocks of
+// the chains they came from.
+void test_slicing_and_concatenation() {
+  using chain::chain;
+
+  chain original("The quick brown fox jumps over the lazy dog.");
+  assert(original.slice(4, 5) == chain("quick"));
+  assert(original.slice(0, 0) == chain(""));
+  assert(original.slice(44, 0) == chain(""));
+  assert(original.slice(0, 44) == original);
+  assert(chain().slice(0, 0) == chain());
+
+  chain edited = original.slice(0, 10) + chain("red") + original.slice(15, 29);
+  assert(edited == chain("The quick red fox jumps over the lazy dog."));
+  assert(chain() + original == original);
+  assert(original + chain() == original);
+  assert(chain() + chain() == chain());
+  assert(chain("") + chain("") == chain(""));
+
+  // Slices and concatenations across page boundaries.
+  std::string contents;
+  for (int i = 0; i < 3000; ++i) contents += "0123456789";
+  chain long_chain(contents);
+  assert(long_chain.slice(4090, 20) == chain(contents.substr(4090, 20)));
+  chain rejoined = long_chain.slice(0, 12345) + long_chain.slice(12345, 17655);
+  assert(rejoined == long_chain);
+
+  // Chains that share most of their links compare the same as ones that
+  // don't share anything.
+  chain copy(contents);
+  chain changed = long_chain.slice(0, 20000) + chain("!") +
+                  long_chain.slice(20001, 9999);
+  assert(rejoined == copy);
+  assert(changed != long_chain && changed != copy);
+  assert(changed < long_chain && changed < copy);
+  assert(long_chain.slice(0, 20000) < long_chain);
+}
+
+// Edits give new chains that share the untouched parts of the original, and
+// leave the original alone.
+void test_editing() {
+  using chain::chain;
+
+  chain original("The quick brown fox jumps over the lazy dog.");
+  assert(original.replace(10, 5, chain("red")) ==
+         chain("The quick red fox jumps over the lazy dog."));
+  assert(original.insert(4, chain("very ")) ==
+         chain("The very quick brown fox jumps over the lazy dog."));
+  assert(original.erase(3, 6) == chain("The brown fox jumps over the lazy dog."));
+  assert(original.insert(44, chain("!")) ==
+         chain("The quick brown fox jumps over the lazy dog.!"));
+  assert(original.erase(0, 44) == chain(""));
+  assert(original.replace(0, 0, chain()) == original);
+  assert(original == chain("The quick brown fox jumps over the lazy dog."));
+  assert(chain().insert(0, chain("Aloha!")) == chain("Aloha!"));
+  assert(chain().erase(0, 0).null());
+
+  // Edits across pages only add the links at either end of the edit, and
+  // taking back out what went in gives the original links back.
+  std::string contents;
+  for (int i = 0; i < 3000; ++i) contents += "0123456789";
+  chain long_chain(contents);
+  size_t links = ::chain::detail::chain_access::links(long_chain)->link_count();
+  chain inserted = long_chain.insert(12345, chain("inserted"));
+  assert(inserted == chain(contents.substr(0, 12345) + "inserted" +
+                           contents.substr(12345)));
+  assert(::chain::detail::chain_access::links(inserted)->link_count() <= links + 2);
+  chain restored = inserted.erase(12345, 8);
+  assert(restored == long_chain);
+  assert(::chain::detail::chain_access::links(restored)->link_count() == links);
+  assert(long_chain.replace(4090, 20, chain("x")) ==
+         chain(contents.substr(0, 4090) + "x" + contents.substr(4110)));
+}
+
+// Replacing all occurrences of a needle finds them across blocks and shares
+// the untouched parts of the original as well as the replacement.
+void test_replace_all() {
+  using chain::chain;
+
+  chain text("one fish two fish red fish blue fish");
+  assert(text.replace_all(chain("fish"), chain("cat")) ==
+         chain("one cat two cat red cat blue cat"));
+  assert(text.replace_all(chain("fish"), chain("")) == chain("one  two  red  blue "));
+  assert(text.replace_all(chain("one fish two fish red fish blue fish"), chain("x")) ==
+         chain("x"));
+  assert(chain("aaaa").replace_all(chain("aa"), chain("b")) == chain("bb"));
+  assert(chain("aaa").replace_all(chain("aa"), chain("b")) == chain("ba"));
+  assert(text.replace_all(chain("dog"), chain("cat")) == text);
+  assert(text.replace_all(chain(""), chain("cat")) == text);
+  assert(chain().replace_all(chain("fish"), chain("cat")).null());
+
+  // Occurrences that start in one page and end in another are found too, and
+  // the pages in between aren't copied.
+  std::string contents;
+  for (int i = 0; i < 3000; ++i) contents += "{{name}} ";
+  chain long_chain(contents);
+  chain name("Aloha");
+  chain rendered = long_chain.replace_all(chain("{{name}}"), name);
+  std::string expected;
+  for (int i = 0; i < 3000; ++i) expected += "Aloha ";
+  assert(rendered == chain(expected));
+  size_t links = ::chain::detail::chain_access::links(long_chain)->link_count();
+  assert(::chain::detail::chain_access::links(rendered)->link_count() <=
+         2 * 3000 + links);
+  chain mixed = chain("abc") + chain("def") + chain("ghi");
+  assert(mixed.replace_all(chain("cdefg"), chain("-")) == chain("ab-hi"));
+  assert(mixed.replace_all(chain("cdx"), chain("-")) == mixed);
+}
+
+// Moving chains around hands their links over without touching reference
+// counts, which is what containers of chains rely on when they grow.
+void test_move() {
+  using chain::detail::link_reference_traffic;
+  using chain::chain;
+
+  static_assert(std::is_nothrow_move_constructible<chain>::value,
+                "Chains have to move without throwing.");
+  static_assert(std::is_nothrow_move_assignable<chain>::value,
+                "Chains have to move without throwing.");
+
+  chain original("Aloha!");
+  size_t traffic = link_reference_traffic();
+  chain moved(std::move(original));
+  assert(link_reference_traffic() == traffic);
+  assert(original.null());
+  assert(moved == chain("Aloha!"));
+
+  chain assigned;
+  traffic = link_reference_traffic();
+  assigned = std::move(moved);
+  assert(link_reference_traffic() == traffic);
+  assert(moved.null());
+  assert(assigned == chain("Aloha!"));
+
+  // Growing a vector of chains moves them into the new storage.
+  std::vector<chain> chains;
+  chains.push_back(assigned);
+  traffic = link_reference_traffic();
+  for (int i = 0; i < 1000; ++i) chains.emplace_back();
+  chains.shrink_to_fit();
+  assert(link_reference_traffic() == traffic);
+  assert(chains.front() == assigned);
+
+  // Copying still shares the links, and moving from the copy leaves the
+  // original alone.
+  chain copy(assigned);
+  chain taken(std::move(copy));
+  assert(assigned == taken && copy.null() && !assigned.null());
+}
+
+// Chains know their size and whether they point to nothing without walking
+// their links.
+void test_size() {
+  using chain::chain;
+
+  chain defaulted, empty(""), short_chain("Aloha!");
+  assert(defaulted.null() && defaulted.empty() && defaulted.size() == 0);
+  assert(!empty.null() && empty.empty() && empty.size() == 0);
+  assert(!short_chain.null() && !short_chain.empty() && short_chain.size() == 6);
+
+  std::string contents;
+  for (int i = 0; i < 3000; ++i) contents += "0123456789";
+  chain long_chain(contents);
+  assert(long_chain.size() == contents.size());
+  assert(long_chain.slice(4090, 20).size() == 20);
+  assert(long_chain.slice(0, 0).size() == 0 && !long_chain.slice(0, 0).null());
+  assert((long_chain + short_chain).size() == contents.size() + 6);
+  assert((defaulted + short_chain).size() == 6);
+  assert(chain(long_chain).size() == contents.size());
+
+  // Chains of different sizes are never equal, even when one is a prefix of
+  // the other.
+  assert(long_chain != long_chain.slice(0, contents.size() - 1));
+  assert(long_chain.slice(0, 10) != long_chain.slice(0, 11));
+}
+
+// Chains can adopt buffers instead of copying them, and let go of them once
+// the last chain referring to them does.
+void test_adoption() {
+  using chain::chain;
+
+  // A buffer with a deleter is handed back to the deleter exactly once.
+  int deleted = 0;
+  char *buffer = new char[13];
+  std::copy_n("Hello, world!", 13, buffer);
+  {
+    chain adopted(buffer, 13, [&deleted](char *b) { ++deleted; delete[] b; });
+    assert(adopted == chain("Hello, world!"));
+    assert(::chain::detail::chain_access::links(adopted)->begin()->data() == buffer);
+    chain sliced = adopted.slice(7, 5);
+    adopted = chain();
+    assert(deleted == 0);
+    assert(sliced == chain("world"));
+    assert(sliced + chain("!") == chain("world!"));
+  }
+  assert(deleted == 1);
+
+  // Buffers in a std::unique_ptr or a std::vector come with what lets go of
+  // them. Buffers bigger than a single block refer to several blocks which
+  // share the buffer.
+  std::unique_ptr<char[]> owned(new char[5]);
+  std::copy_n("Aloha", 5, owned.get());
+  chain from_unique(std::move(owned), 5);
+  assert(from_unique == chain("Aloha"));
+
+  std::vector<char> contents(20 << 20);
+  for (size_t i = 0; i < contents.size(); ++i) contents[i] = char('a' + i % 26);
+  std::string copied(contents.begin(), contents.end());
+  char const *data = contents.data();
+  chain from_vector(std::move(contents));
+  assert(from_vector.size() == copied.size());
+  assert(::chain::detail::chain_access::links(from_vector)->begin()->data() == data);
+  assert(from_vector == chain(copied));
+  assert(from_vector.slice(8388600, 20) == chain(copied.substr(8388600, 20)));
+
+  // An empty buffer gives an empty chain, and goes away right away.
+  deleted = 0;
+  chain empty(new char[1], 0, [&deleted](char *b) { ++deleted; delete[] b; });
+  assert(empty.empty() && !empty.null() && deleted == 1);
+}
+
+// Pages that no chain refers to anymore go into a pool from which later chains
+// get their pages, up to a limit.
+void test_page_pool() {
+  using chain::page_pool;
+  using chain::chain;
+
+  typedef page_pool<chain> pool;
+  pool::trim();
+  assert(pool::size() == 0);
+  std::string contents(10 * getpagesize(), 'x');
+  { chain c(contents); }
+  size_t pooled = pool::size();
+  assert(pooled >= 9);
+  { chain c(contents); }
+  assert(pool::size() <= pooled + 1);
+
+  // Going over the high watermark lets go of pages down to the low watermark.
+  pool::set_watermarks(2, 4);
+  assert(pool::size() == 2);
+  { chain c(contents); }
+  assert(pool::size() <= 4);
+
+  // Without a high watermark there's no pool at all.
+  pool::set_watermarks(0, 0);
+  assert(pool::size() == 0);
+  { chain c(contents); }
+  assert(pool::size() == 0);
+  pool::set_watermarks(64, 256);
+}
+
+// Chains with stateful allocators don't share the last page with anything,
+// so once they're gone nothing refers to the allocator they used, and a chain
+// with another allocator never has to give back a page through it.
+void test_allocator_lifetime() {
+  typedef ::chain::chain_t<char, scoped_allocator<char>> scoped_chain;
+  typedef std::basic_string<char, std::char_traits<char>, scoped_allocator<char>>
+      scoped_string;
+  scoped_string contents("The quick brown fox.");
+  scoped_string large(3 * getpagesize(), 'x');
+  {
+    scoped_allocator<char> first(1);
+    scoped_chain c(contents, &first), d(large, &first);
+    assert(c.size() == contents.size() && d.size() == large.size());
+  }
+  scoped_allocator<char> second(2);
+  scoped_chain c(contents, &second), d(large, &second);
+  assert(c.size() == contents.size() && d.size() == large.size());
 }
 
 int main(int argc, char *argv[]) {
@@ -173,9 +662,19 @@ int main(int argc, char *argv[]) {
   // first set of tests verify that the chain type behaves very much like a
   // value type.
   test_construction();
+  test_validated_construction();
   test_copy();
   test_assignment();
   test_swap();
+  test_ordering();
+  test_slicing_and_concatenation();
+  test_size();
+  test_editing();
+  test_replace_all();
+  test_move();
+  test_adoption();
+  test_page_pool();
+  test_allocator_lifetime();
 
   // Once we reach this point we are certain that the usage tests are all good.
   return 0;
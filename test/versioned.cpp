@@ -0,0 +1,84 @@
+// Copyright 2012 Dean Michael Berris <dberris@google.com>.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// We want to test that a versioned chain keeps the versions its retention
+// policy says it should, and only charges each version for what its edits
+// brought in.
+#include <chain/versioned.hpp>
+
+// We also want to be able to assert that our assumptions and understanding is
+// correct.
+#include <cassert>
+#include <string>
+
+#include <unistd.h>
+
+// Replaces a few elements in the middle of the chain, sharing the rest.
+chain::chain edit(chain::chain const &c, size_t position, char const *text) {
+  size_t length = std::string(text).size();
+  return c.slice(0, position) + chain::chain(std::string(text)) +
+         c.slice(position + length, c.size() - position - length);
+}
+
+void test_history() {
+  using chain::versioned_chain;
+  using chain::chain;
+
+  std::string contents(100 * getpagesize(), 'x');
+  chain document(contents);
+  versioned_chain<chain> history;
+  assert(history.commit(document) == 0);
+  assert(history.incremental_size(0) >= contents.size());
+
+  for (size_t v = 1; v <= 50; ++v) {
+    document = edit(document, v * 1000, "edited");
+    assert(history.commit(document) == v);
+    // An edit only costs the elements it brought in and the links, which
+    // gain two with every edit.
+    assert(history.incremental_size(v) < contents.size() / 10);
+    if (v > 1) {
+      assert(history.incremental_size(v) - history.incremental_size(v - 1) ==
+             2 * sizeof(::chain::detail::packed_link<char, std::allocator<char>>));
+    }
+  }
+  assert(history.committed() == 51);
+  assert(history.at(0) == chain(contents));
+  assert(history.at(50) == document);
+  assert(history.at(10).slice(10000, 6) == chain("edited"));
+  assert(history.at(9).slice(10000, 6) == chain("xxxxxx"));
+}
+
+void test_retention() {
+  using chain::versioned_chain;
+  using chain::chain;
+
+  versioned_chain<chain> history(3);
+  chain document("Hello, world!");
+  history.commit(document);
+  history.pin(0);
+  for (size_t v = 1; v < 10; ++v) {
+    document = edit(document, 0, v % 2 ? "J" : "H");
+    history.commit(document);
+  }
+  // The latest three are kept, along with the pinned one.
+  assert(history.contains(0) && history.at(0) == chain("Hello, world!"));
+  assert(!history.contains(1) && !history.contains(6));
+  assert(history.contains(7) && history.contains(8) && history.contains(9));
+  assert(history.at(9) == chain("Jello, world!"));
+
+  history.unpin(0);
+  assert(!history.contains(0));
+  history.retain(0);
+  assert(!history.contains(8) && history.contains(9) && history.last() == 9);
+  history.retain(versioned_chain<chain>::keep_all);
+  history.commit(chain("Goodbye."));
+  assert(history.contains(9) && history.contains(10));
+}
+
+int main(int argc, char *argv[]) {
+  test_history();
+  test_retention();
+  return 0;
+}